@@ -0,0 +1,244 @@
+// Benchmark suite tracking the performance of the renderer between versions. Runs
+// microbenchmarks of the hot-path operations and full renders of the demo scene, and prints
+// the results as JSON: ns/op for every benchmark and rays/s for the renders.
+//
+// Options: --filter <substring> only runs the benchmarks whose name contains the substring,
+//          --min-time <seconds> sets how long every microbenchmark runs (default 0.25).
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "BVH.hpp"
+#include "Camera.hpp"
+#include "DemoScene.hpp"
+#include "SpherePacket.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+constexpr size_t input_count = 1024; // Inputs every microbenchmark cycles through
+
+struct Result{
+    std::string name;
+    uint64_t operations;
+    double seconds;
+    uint64_t rays; // Rays traced, 0 for benchmarks that don't trace rays
+};
+
+class Suite{
+private:
+    std::string_view filter;
+    double min_time = 0.25;
+    std::vector<Result> results;
+    double sink = 0; // Consumes the benchmark outputs, so they can't be optimized away
+
+    inline bool selected(const std::string_view name) const noexcept {
+        return name.find(filter) != std::string_view::npos;
+    }
+public:
+    inline Suite(const std::string_view name_filter, const double minimum_time) noexcept
+        : filter(name_filter), min_time(minimum_time) {}
+
+    /// @brief Repeats the operation over the inputs until min_time has passed.
+    /// `operation(i)` processes input i % input_count and returns a value for the sink.
+    template<typename Operation>
+    inline void measure(const std::string_view name, Operation&& operation) {
+        if(!selected(name)){
+            return;
+        }
+        std::clog << name << '\n';
+        uint64_t operations = 0;
+        const steady_clock::time_point start = steady_clock::now();
+        double elapsed;
+        do{
+            for(size_t i = 0;i < input_count;i++){
+                sink += operation(i);
+            }
+            operations += input_count;
+            elapsed = chrono::duration<double>(steady_clock::now() - start).count();
+        }while(elapsed < min_time);
+        results.push_back(Result{std::string(name), operations, elapsed, 0});
+    }
+
+    /// @brief Renders the demo scene once and records the rays traced per second, which every
+    /// thread counts into its own RenderStats. The render is instantiated for the types of the
+    /// world and the materials, see dispatch_scene.
+    template<typename World, typename Materials>
+    inline void render(const std::string_view name, const World& world, const Materials& materials,
+        const Camera& camera, const RenderSettings& settings) {
+        if(!selected(name)){
+            return;
+        }
+        std::clog << name << '\n';
+        RenderStats stats;
+        const steady_clock::time_point start = steady_clock::now();
+        const Framebuffer image = camera.render_image(world, materials, settings, &stats);
+        const double elapsed = chrono::duration<double>(steady_clock::now() - start).count();
+        sink += image.pixels.front().x();
+        results.push_back(Result{std::string(name), 1, elapsed, stats.rays()});
+    }
+
+    inline void print_json(std::ostream& out) const {
+        static const char* const simd_names[] = {"scalar", "avx2", "avx512"};
+        out << "{\n  \"real_bytes\": " << sizeof(Real) << ",\n  \"vec3_bytes\": " << sizeof(Vec3)
+            << ",\n  \"simd\": \"" << simd_names[static_cast<uint8_t>(detect_simd_level())]
+            << "\",\n  \"benchmarks\": [";
+        for(size_t i = 0;i < results.size();i++){
+            const Result& result = results[i];
+            out << (i == 0? "\n" : ",\n") << "    {\"name\": \"" << result.name
+                << "\", \"operations\": " << result.operations
+                << ", \"seconds\": " << result.seconds
+                << ", \"ns_per_op\": " << result.seconds * 1e9 / result.operations;
+            if(result.rays > 0){
+                out << ", \"rays\": " << result.rays
+                    << ", \"rays_per_second\": " << result.rays / result.seconds;
+            }
+            out << '}';
+        }
+        out << "\n  ],\n  \"checksum\": " << sink << "\n}\n";
+    }
+};
+
+int main(const int argc, const char* const argv[]){
+    std::string_view filter;
+    double min_time = 0.25;
+    for(int i = 1;i < argc;i += 2){
+        const std::string_view option = argv[i];
+        if(i + 1 == argc){
+            std::clog << "Missing value for option: " << option << '\n';
+            return EXIT_FAILURE;
+        }
+        if(option == "--filter"){
+            filter = argv[i + 1];
+        }else if(option == "--min-time"){
+            min_time = std::strtod(argv[i + 1], nullptr);
+        }else{
+            std::clog << "Unknown option: " << option << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    Suite suite(filter, min_time);
+
+    // Inputs
+    seed_random(0, 0);
+    const Scene scene = demo_scene();
+    const HittableList list = scene.world();
+    const BVH bvh(list);
+    std::vector<Ray> scene_rays, sphere_rays;
+    std::vector<Vec3> vectors;
+    std::vector<HitRecord> records;
+    for(size_t i = 0;i < input_count;i++){
+        // Rays from around the camera into the scene, and rays aimed near the unit sphere
+        scene_rays.emplace_back(Point3(13, 2, 3) + Vec3::random(-1, 1),
+            Point3::random(-8, 8) * Vec3(1, 0.1, 1) - Point3(13, 2, 3));
+        sphere_rays.emplace_back(Point3::random(-5, 5) + Point3(0, 0, 10),
+            Point3::random(-1.5, 1.5) - Point3(0, 0, 10));
+        vectors.push_back(Vec3::random(-1, 1));
+
+        HitRecord record;
+        record.material = 0;
+        record.time = 1;
+        record.point = Point3(0, 0, 1);
+        record.set_face_normal(sphere_rays.back(), Vec3(0, 0, 1));
+        records.push_back(record);
+    }
+    SphereStorage unit_sphere;
+    unit_sphere.add(Point3(0, 0, 0), 1, 0);
+    const Sphere sphere(unit_sphere, 0);
+
+    // Intersection
+    suite.measure("sphere_hit", [&](const size_t i){
+        HitRecord record;
+        return sphere.hit(sphere_rays[i], Interval(0.001, INFINITY), record)? record.time : 0;
+    });
+    suite.measure("hittable_list_hit_demo", [&](const size_t i){
+        HitRecord record;
+        return list.hit(scene_rays[i], Interval(0.001, INFINITY), record)? record.time : 0;
+    });
+    suite.measure("bvh_hit_demo", [&](const size_t i){
+        HitRecord record;
+        return bvh.hit(scene_rays[i], Interval(0.001, INFINITY), record)? record.time : 0;
+    });
+
+    // Vector operations
+    suite.measure("vec3_add", [&](const size_t i){
+        return (vectors[i] + vectors[(i + 1) % input_count]).x();
+    });
+    suite.measure("vec3_dot", [&](const size_t i){
+        return vectors[i].dot(vectors[(i + 1) % input_count]);
+    });
+    suite.measure("vec3_cross", [&](const size_t i){
+        return vectors[i].cross(vectors[(i + 1) % input_count]).y();
+    });
+    suite.measure("vec3_unit_vector", [&](const size_t i){
+        return vectors[i].unit_vector().z();
+    });
+
+    // Sampling
+    RandomStream rng(1);
+    suite.measure("random_unit_vector", [&](size_t){
+        return Vec3::random_unit_vector(rng).x();
+    });
+    suite.measure("random_in_unit_disk", [&](size_t){
+        return Vec3::random_in_unit_disk(rng).x();
+    });
+    for(const auto& [name, pattern] : {
+        std::pair<const char*, SamplePattern>{"sampler_independent", SamplePattern::Independent},
+        {"sampler_stratified", SamplePattern::Stratified}, {"sampler_sobol", SamplePattern::Sobol},
+        {"sampler_blue_noise", SamplePattern::BlueNoise}}){
+        // A sample of a pixel of a 64x64 image with 64 samples per pixel, as for camera rays
+        suite.measure(name, [&](const size_t i){
+            const uint32_t pixel = static_cast<uint32_t>(i % 4096);
+            Sampler sampler(pattern, 1, 0, pixel % 64, pixel / 64, pixel, static_cast<uint32_t>(i / 4096 % 64), 64);
+            return sampler.unit_vector().x() + sampler.in_unit_disk().x();
+        });
+    }
+
+    // Scattering
+    MaterialTable materials;
+    const uint32_t lambertian = materials.add<Lambertian>(Color(0.5, 0.5, 0.5));
+    const uint32_t metal = materials.add<Metal>(Color(0.7, 0.6, 0.5), 0.3);
+    const uint32_t dielectric = materials.add<Dielectric>(1.5);
+    BuiltinMaterialTable builtin_materials;
+    builtin_materials.assign(materials);
+    Sampler sampler;
+    for(const auto& [name, material] : {std::pair<const char*, uint32_t>{"scatter_lambertian", lambertian},
+        {"scatter_metal", metal}, {"scatter_dielectric", dielectric}}){
+        suite.measure(name, [&](const size_t i){
+            Color attenuation;
+            Ray scattered;
+            materials[material].scatter(sphere_rays[i], records[i], attenuation, scattered, sampler);
+            return scattered.direction().x();
+        });
+        suite.measure(std::string(name) + "_builtin", [&](const size_t i){
+            Color attenuation;
+            Ray scattered;
+            builtin_materials[material].scatter(sphere_rays[i], records[i], attenuation, scattered, sampler);
+            return scattered.direction().x();
+        });
+    }
+
+    // Full frames of the demo scene
+    RenderSettings settings;
+    settings.progress_interval = chrono::hours(1);
+    BuiltinMaterialTable demo_materials;
+    demo_materials.assign(scene.materials);
+    const Hittable& virtual_bvh = bvh;
+    suite.render("render_demo_bvh_240x135_16spp", bvh, demo_materials, demo_camera(240, 16), settings);
+    suite.render("render_demo_bvh_virtual_240x135_16spp", virtual_bvh, scene.materials, demo_camera(240, 16),
+        settings);
+    suite.render("render_demo_bvh_480x270_4spp", bvh, demo_materials, demo_camera(480, 4), settings);
+    settings.integrator = Integrator::Wavefront;
+    suite.render("render_demo_bvh_wavefront_240x135_16spp", bvh, demo_materials, demo_camera(240, 16),
+        settings);
+    suite.render("render_demo_bvh_wavefront_virtual_240x135_16spp", virtual_bvh, scene.materials,
+        demo_camera(240, 16), settings);
+    settings.integrator = Integrator::Recursive;
+    suite.render("render_demo_list_120x67_8spp", list, demo_materials, demo_camera(120, 8), settings);
+
+    suite.print_json(std::cout);
+}
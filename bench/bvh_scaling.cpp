@@ -0,0 +1,57 @@
+// Measures the cost of a ray query against a growing number of spheres, comparing the
+// linear scan of HittableList with the BVH. The BVH cost should grow roughly logarithmically.
+#include <iostream>
+#include <cstdint>
+#include <chrono>
+
+#include "Scene.hpp"
+#include "BVH.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+constexpr uint32_t ray_count = 100000;
+constexpr size_t linear_limit = 10000; // Larger lists take too long to scan linearly
+
+/// @brief Returns the average time in nanoseconds a ray query takes.
+inline double nanoseconds_per_ray(const Hittable& world) {
+    seed_random(1, 0);
+    uint32_t hits = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    for(uint32_t i = 0;i < ray_count;i++){
+        const Ray ray(Point3::random(-60, 60), Vec3::random_unit_vector());
+        HitRecord record;
+        hits += world.hit(ray, Interval(0.001, INFINITY), record);
+    }
+    const double elapsed = chrono::duration<double, std::nano>(steady_clock::now() - start).count();
+    if(hits == 0){
+        std::clog << "No ray hit anything\n";
+    }
+    return elapsed / ray_count;
+}
+
+int main(){
+    std::cout << "spheres,linear_ns_per_ray,bvh_ns_per_ray,bvh_build_ms\n";
+    for(size_t sphere_count = 100;sphere_count <= 1000000;sphere_count *= 10){
+        // Keep the density constant, so the number of spheres a ray can hit stays comparable
+        seed_random(0, sphere_count);
+        const double extent = 50 * std::cbrt(sphere_count / 1000.0);
+        Scene scene;
+        const uint32_t material = scene.add_material<Lambertian>(Color(0.5, 0.5, 0.5));
+        scene.spheres.reserve(sphere_count);
+        for(size_t i = 0;i < sphere_count;i++){
+            scene.add_sphere(Point3::random(-extent, extent), 0.5, material);
+        }
+        const HittableList world = scene.world();
+
+        const steady_clock::time_point build_start = steady_clock::now();
+        const BVH bvh(world);
+        const double build_ms = chrono::duration<double, std::milli>(steady_clock::now() - build_start).count();
+
+        std::cout << sphere_count << ',';
+        if(sphere_count <= linear_limit){
+            std::cout << nanoseconds_per_ray(world);
+        }
+        std::cout << ',' << nanoseconds_per_ray(bvh) << ',' << build_ms << std::endl;
+    }
+}
@@ -0,0 +1,94 @@
+// Measures scenes made of many instances of one complex object: the memory a scene takes and
+// the cost of a ray query as the instance count grows, which should both stay proportional to
+// the instance count and independent of the primitives the instances show. Also checks that an
+// instance hits the same spheres as a copy of the geometry that was transformed up front.
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+
+#include <sys/resource.h>
+
+#include "Scene.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+constexpr uint32_t prototype_spheres = 1000;
+constexpr uint32_t ray_count = 100000;
+
+/// @brief Returns the peak resident memory of the process in MiB.
+inline double peak_memory_mib() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+/// @brief Returns a random rotation, uniform scale and translation within the extent.
+inline Transform random_placement(const double extent) {
+    return Transform::translation(Vec3::random(-extent, extent) * Vec3(1, 0, 1))
+        * Transform::rotation(Vec3::random_unit_vector(), random_double(0, 360))
+        * Transform::scaling(random_double(0.5, 2));
+}
+
+int main(){
+    seed_random(0, 0);
+    Scene scene;
+    const uint32_t material = scene.add_material<Lambertian>(Color(0.5, 0.5, 0.5));
+    SphereStorage cluster;
+    for(uint32_t i = 0;i < prototype_spheres;i++){
+        cluster.add(Vec3::random_unit_vector() * std::cbrt(random_double()) * 4, 0.2, material);
+    }
+    const BVH& prototype = scene.add_prototype(HittableList(cluster));
+
+    // An instance must hit like the transformed geometry
+    const Transform placement = random_placement(10);
+    SphereStorage transformed;
+    const double scale = placement.vector(Vec3(1, 0, 0)).length();
+    for(uint32_t i = 0;i < prototype_spheres;i++){
+        transformed.add(placement.point(cluster.geometry.center(i)), cluster.geometry.radius[i] * scale, material);
+    }
+    const Instance instance(prototype, placement);
+    const BVH reference((HittableList(transformed)));
+    uint32_t hits = 0, mismatches = 0;
+    for(uint32_t i = 0;i < ray_count;i++){
+        const Ray ray(Point3::random(-30, 30), Vec3::random_unit_vector());
+        HitRecord instance_record, reference_record;
+        const bool instance_hit = instance.hit(ray, Interval(0.001, INFINITY), instance_record);
+        const bool reference_hit = reference.hit(ray, Interval(0.001, INFINITY), reference_record);
+        hits += reference_hit;
+        if(instance_hit != reference_hit || (reference_hit &&
+            (std::fabs(instance_record.time - reference_record.time) > 1e-9 * reference_record.time ||
+            (instance_record.normal - reference_record.normal).length() > 1e-9 ||
+            instance_record.front_face != reference_record.front_face))){
+            mismatches++;
+        }
+    }
+    std::clog << hits << " of " << ray_count << " rays hit, " << mismatches << " mismatches\n";
+
+    std::cout << "instances,primitives,peak_memory_mib,bvh_build_ms,ns_per_ray\n";
+    for(size_t instance_count = 1000;instance_count <= 1000000;instance_count *= 10){
+        seed_random(1, instance_count);
+        // Keep the density constant, so the number of instances a ray passes stays comparable
+        const double extent = 100 * std::sqrt(instance_count / 1000.0);
+        scene.instances.clear();
+        for(size_t i = 0;i < instance_count;i++){
+            scene.add_instance(prototype, random_placement(extent));
+        }
+
+        const steady_clock::time_point build_start = steady_clock::now();
+        const BVH world(scene.world());
+        const double build_ms = chrono::duration<double, std::milli>(steady_clock::now() - build_start).count();
+
+        const steady_clock::time_point start = steady_clock::now();
+        for(uint32_t i = 0;i < ray_count;i++){
+            const Ray ray(Point3::random(-extent, extent) * Vec3(1, 0, 1) + Vec3(0, 20, 0),
+                Vec3::random_unit_vector() - Vec3(0, 1, 0));
+            HitRecord record;
+            hits += world.hit(ray, Interval(0.001, INFINITY), record);
+        }
+        const double elapsed = chrono::duration<double, std::nano>(steady_clock::now() - start).count();
+        std::cout << instance_count << ',' << instance_count * prototype_spheres << ','
+            << peak_memory_mib() << ',' << build_ms << ',' << elapsed / ray_count << std::endl;
+    }
+}
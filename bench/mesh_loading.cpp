@@ -0,0 +1,148 @@
+// Measures triangle meshes of a growing number of triangles: how long loading the OBJ and the
+// binary PLY form takes, the time to build the mesh's BVH, the memory the mesh takes and the
+// cost of a ray query. The mesh is a closed, tessellated sphere, and every ray starts inside
+// it and is aimed at one of its vertices, where six triangles meet, so rays slipping through
+// the seams between triangles show up as misses, which must stay 0.
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "MeshLoader.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+constexpr size_t obj_limit = 1000000; // Larger OBJ files take too long to write
+constexpr uint32_t ray_count = 100000;
+
+/// @brief Returns the peak resident memory of the process in MiB.
+inline double peak_memory_mib() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+/// @brief Returns a unit sphere of about `triangle_count` triangles, rows of quads between the
+/// poles split in two, the rows at the poles degenerating into fans.
+inline MeshData tessellated_sphere(const size_t triangle_count) {
+    const uint32_t rows = std::max<uint32_t>(2, static_cast<uint32_t>(std::sqrt(triangle_count / 4.0)));
+    const uint32_t columns = 2 * rows;
+    MeshData mesh;
+    mesh.vertices.push_back(MeshVertex{0, 1, 0});
+    for(uint32_t row = 1;row < rows;row++){
+        const double theta = M_PI * row / rows;
+        for(uint32_t column = 0;column < columns;column++){
+            const double phi = 2 * M_PI * column / columns;
+            mesh.vertices.push_back(MeshVertex{static_cast<float>(std::sin(theta) * std::cos(phi)),
+                static_cast<float>(std::cos(theta)), static_cast<float>(std::sin(theta) * std::sin(phi))});
+        }
+    }
+    mesh.vertices.push_back(MeshVertex{0, -1, 0});
+
+    // Vertex of a row and column, rows 0 and `rows` being the poles
+    const auto vertex = [&](const uint32_t row, const uint32_t column){
+        return row == 0? 0 : row == rows? static_cast<uint32_t>(mesh.vertices.size() - 1) :
+            1 + (row - 1) * columns + column % columns;
+    };
+    for(uint32_t row = 0;row < rows;row++){
+        for(uint32_t column = 0;column < columns;column++){
+            const uint32_t a = vertex(row, column), b = vertex(row, column + 1);
+            const uint32_t c = vertex(row + 1, column), d = vertex(row + 1, column + 1);
+            if(row > 0){
+                mesh.indices.insert(mesh.indices.end(), {a, b, c});
+            }
+            if(row + 1 < rows){
+                mesh.indices.insert(mesh.indices.end(), {b, d, c});
+            }
+        }
+    }
+    return mesh;
+}
+
+inline void save_obj(const MeshData& mesh, const std::string& path) {
+    std::ofstream out(path);
+    for(const MeshVertex& vertex : mesh.vertices){
+        out << "v " << vertex.x << ' ' << vertex.y << ' ' << vertex.z << '\n';
+    }
+    for(size_t i = 0;i < mesh.indices.size();i += 3){
+        out << "f " << mesh.indices[i] + 1 << ' ' << mesh.indices[i + 1] + 1 << ' ' << mesh.indices[i + 2] + 1 << '\n';
+    }
+}
+
+inline void save_binary_ply(const MeshData& mesh, const std::string& path) {
+    const uint16_t probe = 1;
+    const bool little_endian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+    std::ofstream out(path, std::ios::binary);
+    out << "ply\nformat " << (little_endian? "binary_little_endian" : "binary_big_endian") << " 1.0\n"
+        << "element vertex " << mesh.vertices.size() << "\nproperty float x\nproperty float y\nproperty float z\n"
+        << "element face " << mesh.triangle_count() << "\nproperty list uchar uint vertex_indices\nend_header\n";
+    out.write(reinterpret_cast<const char*>(mesh.vertices.data()),
+        static_cast<std::streamsize>(mesh.vertices.size() * sizeof(MeshVertex)));
+    for(size_t i = 0;i < mesh.indices.size();i += 3){
+        const uint8_t count = 3;
+        out.write(reinterpret_cast<const char*>(&count), 1);
+        out.write(reinterpret_cast<const char*>(&mesh.indices[i]), 3 * sizeof(uint32_t));
+    }
+}
+
+/// @brief Loads the mesh file into `mesh` and returns the time it took in milliseconds.
+inline double load_milliseconds(const std::string& path, const size_t triangle_count, MeshData& mesh) {
+    std::string error;
+    const steady_clock::time_point start = steady_clock::now();
+    const bool loaded = load_mesh(path, mesh, error);
+    const double elapsed = chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+    if(!loaded || mesh.triangle_count() != triangle_count){
+        std::clog << path << ": " << (loaded? "wrong triangle count" : error) << '\n';
+    }
+    return elapsed;
+}
+
+int main(){
+    const std::string obj_path = "mesh_loading_bench.obj";
+    const std::string ply_path = "mesh_loading_bench.ply";
+    std::cout << "triangles,obj_load_ms,ply_load_ms,bvh_build_ms,mesh_mib,peak_memory_mib,ns_per_ray,misses\n";
+    for(size_t target = 10000;target <= 10000000;target *= 10){
+        size_t triangle_count;
+        {
+            const MeshData generated = tessellated_sphere(target);
+            triangle_count = generated.triangle_count();
+            save_binary_ply(generated, ply_path);
+            if(target <= obj_limit){
+                save_obj(generated, obj_path);
+            }
+        }
+
+        MeshData data;
+        std::cout << triangle_count << ',';
+        if(target <= obj_limit){
+            std::cout << load_milliseconds(obj_path, triangle_count, data);
+        }
+        std::cout << ',' << load_milliseconds(ply_path, triangle_count, data) << ',';
+
+        const std::vector<MeshVertex> vertices = data.vertices;
+        const steady_clock::time_point build_start = steady_clock::now();
+        const TriangleMesh mesh(std::move(data), 0);
+        std::cout << chrono::duration<double, std::milli>(steady_clock::now() - build_start).count() << ','
+            << mesh.memory_bytes() / (1024.0 * 1024.0) << ',' << peak_memory_mib() << ',';
+
+        seed_random(0, triangle_count);
+        uint32_t misses = 0;
+        const steady_clock::time_point start = steady_clock::now();
+        for(uint32_t i = 0;i < ray_count;i++){
+            const Point3 origin = Vec3::random_unit_vector() * (0.5 * std::cbrt(random_double()));
+            const Point3 target_vertex = vertices[static_cast<size_t>(random_double() * vertices.size())].point();
+            HitRecord record;
+            misses += !mesh.hit(Ray(origin, target_vertex - origin), Interval(0.001, INFINITY), record);
+        }
+        std::cout << chrono::duration<double, std::nano>(steady_clock::now() - start).count() / ray_count
+            << ',' << misses << std::endl;
+    }
+    std::remove(obj_path.c_str());
+    std::remove(ply_path.c_str());
+}
@@ -0,0 +1,99 @@
+// Counts the heap allocations of a render, for both integrators and for a frame of a single
+// tile and of many tiles. The difference divided by the extra tiles is what a tile allocates,
+// which should be close to zero: the per-tile buffers come from the per-thread scratch arenas,
+// only the task queues of the thread pool grow by a block now and then.
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "DemoScene.hpp"
+#include "Scene.hpp"
+
+namespace{
+std::atomic<size_t> allocations{0};
+std::atomic<bool> counting{false};
+
+/// @brief Counts an allocation and makes it, every operator new below ends up here.
+void* allocate(const size_t size, const size_t alignment){
+    if(counting){
+        allocations++;
+    }
+    // aligned_alloc wants the size to be a multiple of the alignment
+    void* const memory = alignment <= alignof(std::max_align_t)? std::malloc(size > 0? size : 1)
+        : std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment);
+    if(memory == nullptr){
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+// Not inlined, so the compiler doesn't see free releasing memory from operator new and warn
+[[gnu::noinline]] void deallocate(void* const memory) noexcept {
+    std::free(memory);
+}
+}
+
+// The array and nothrow forms call these
+void* operator new(const size_t size){
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment){
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* const memory) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void* const memory, size_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void* const memory, std::align_val_t) noexcept {
+    deallocate(memory);
+}
+
+void operator delete(void* const memory, size_t, std::align_val_t) noexcept {
+    deallocate(memory);
+}
+
+/// @brief Returns the heap allocations a render of the first `tiles` tiles makes.
+inline size_t render_allocations(const Camera& camera, const BVH& world, const Scene& scene,
+    RenderSettings settings, const size_t tiles) {
+    settings.tile_end = tiles;
+    allocations = 0;
+    counting = true;
+    camera.render_image(world, scene.materials, settings);
+    counting = false;
+    return allocations;
+}
+
+int main(){
+    constexpr size_t tile_counts[2] = {1, 1000};
+    const Scene scene = demo_scene();
+    const BVH world(scene.world());
+    CameraParameters parameters = scene.camera;
+    parameters.image_width = 160;
+    parameters.samples_per_pixel = 8;
+    const Camera camera = parameters.camera();
+
+    std::clog.setstate(std::ios::failbit); // Progress output allocates
+    std::cout << "integrator,allocations_one_tile,allocations_many_tiles,allocations_per_tile\n";
+    for(const Integrator integrator : {Integrator::Recursive, Integrator::Wavefront}){
+        RenderSettings settings;
+        settings.integrator = integrator;
+        settings.tile_size = 8;
+        // The first render creates the worker threads and their buffers, which are kept
+        camera.render_image(world, scene.materials, settings);
+        const size_t one = render_allocations(camera, world, scene, settings, tile_counts[0]);
+        const size_t many = render_allocations(camera, world, scene, settings, tile_counts[1]);
+        std::printf("%s,%zu,%zu,%.3f\n", integrator == Integrator::Wavefront? "wavefront" : "recursive",
+            one, many, static_cast<double>(many - one) / (tile_counts[1] - tile_counts[0]));
+    }
+}
@@ -0,0 +1,63 @@
+// Measures how long loading a scene file takes for a growing number of spheres, comparing the
+// text form with the memory-mapped binary form. Loading the binary form should stay in the
+// tens of milliseconds up to 10^7 spheres, as it reads every sphere once to validate its
+// center, radius and material index, but neither parses nor copies them.
+#include <iostream>
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "SceneFile.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+constexpr size_t text_limit = 1000000; // Larger text files take too long to write and parse
+
+/// @brief Returns the time in milliseconds load_scene takes for the file.
+inline double load_milliseconds(const std::string& path, const size_t sphere_count) {
+    Scene scene;
+    std::string error;
+    const steady_clock::time_point start = steady_clock::now();
+    const bool loaded = load_scene(path, scene, error);
+    const double elapsed = chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+    if(!loaded || scene.spheres.size() != sphere_count){
+        std::clog << path << ": " << (loaded? "wrong sphere count" : error) << '\n';
+    }
+    return elapsed;
+}
+
+int main(){
+    const std::string text_path = "scene_loading_bench.txt";
+    const std::string binary_path = "scene_loading_bench.rts";
+    std::cout << "spheres,text_load_ms,binary_load_ms,binary_bytes\n";
+    for(size_t sphere_count = 1000;sphere_count <= 10000000;sphere_count *= 10){
+        seed_random(0, sphere_count);
+        Scene scene;
+        for(uint8_t i = 0;i < 64;i++){
+            scene.add_material<Lambertian>(Color::random());
+        }
+        scene.spheres.reserve(sphere_count);
+        for(size_t i = 0;i < sphere_count;i++){
+            scene.add_sphere(Point3::random(-100, 100), 0.5, static_cast<uint32_t>(i % 64));
+        }
+
+        std::ofstream binary(binary_path, std::ios::binary);
+        std::string error;
+        save_scene_binary(scene, binary, error); // Spheres only, which the binary form always holds
+        binary.close();
+        std::cout << sphere_count << ',';
+        if(sphere_count <= text_limit){
+            std::ofstream text(text_path);
+            save_scene_text(scene, text);
+            text.close();
+            std::cout << load_milliseconds(text_path, sphere_count);
+        }
+        std::cout << ',' << load_milliseconds(binary_path, sphere_count) << ','
+            << std::ifstream(binary_path, std::ios::binary | std::ios::ate).tellg() << std::endl;
+    }
+    std::remove(text_path.c_str());
+    std::remove(binary_path.c_str());
+}
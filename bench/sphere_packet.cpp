@@ -0,0 +1,50 @@
+// Compares the scalar and vectorized sphere kernels on random rays, checking that every
+// kernel the processor supports returns exactly the same nearest hits.
+#include <iostream>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+
+#include "SpherePacket.hpp"
+#include "util.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+constexpr uint32_t ray_count = 20000;
+
+int main(){
+    const SimdLevel supported = detect_simd_level();
+    std::cout << "spheres,kernel,ns_per_ray,mismatches\n";
+    for(size_t sphere_count = 8;sphere_count <= 4096;sphere_count *= 8){
+        seed_random(0, sphere_count);
+        SphereArrays spheres;
+        for(size_t i = 0;i < sphere_count;i++){
+            spheres.push_back(Point3::random(-20, 20), random_double(0.1, 2));
+        }
+        std::vector<Ray> rays;
+        for(uint32_t i = 0;i < ray_count;i++){
+            rays.emplace_back(Point3::random(-25, 25), Vec3::random_unit_vector());
+        }
+
+        std::vector<SphereHit> reference;
+        for(const Ray& ray : rays){
+            reference.push_back(nearest_sphere_hit_scalar(spheres, ray, Interval(0.001, INFINITY), 0,
+                spheres.size()));
+        }
+
+        for(uint8_t level = 0;level <= static_cast<uint8_t>(supported);level++){
+            const NearestSphereKernel kernel = nearest_sphere_kernel(static_cast<SimdLevel>(level));
+            uint32_t mismatches = 0;
+            const steady_clock::time_point start = steady_clock::now();
+            for(uint32_t i = 0;i < ray_count;i++){
+                const SphereHit hit = kernel(spheres, rays[i], Interval(0.001, INFINITY), 0, spheres.size());
+                mismatches += hit.index != reference[i].index || hit.time != reference[i].time;
+            }
+            const double elapsed = chrono::duration<double, std::nano>(steady_clock::now() - start).count();
+            static const char* const names[] = {"scalar", "avx2", "avx512"};
+            std::cout << sphere_count << ',' << names[level] << ',' << elapsed / ray_count << ','
+                << mismatches << '\n';
+        }
+    }
+}
@@ -0,0 +1,73 @@
+// Times the core Vec3 and Ray operations over arrays of random vectors. Build with
+// RAY_TRACER_FLOAT and/or RAY_TRACER_VEC3_PADDED to compare the precision and layout settings.
+#include <iostream>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+
+#include "Ray.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+constexpr size_t vector_count = 4096;
+constexpr uint32_t repetitions = 2000;
+
+/// @brief Runs the operation over every vector index repeatedly and prints the time per call.
+template<typename Operation>
+inline void measure(const char* const name, Operation&& operation) {
+    Real checksum = 0;
+    const steady_clock::time_point start = steady_clock::now();
+    for(uint32_t repetition = 0;repetition < repetitions;repetition++){
+        for(size_t i = 0;i < vector_count;i++){
+            checksum += operation(i);
+        }
+    }
+    const double elapsed = chrono::duration<double, std::nano>(steady_clock::now() - start).count();
+    std::cout << name << ',' << elapsed / (static_cast<double>(repetitions) * vector_count) << ','
+        << checksum << '\n';
+}
+
+int main(){
+    std::vector<Vec3> a, b;
+    for(size_t i = 0;i < vector_count;i++){
+        a.push_back(Vec3::random(-1, 1));
+        b.push_back(Vec3::random(-1, 1));
+    }
+    std::vector<Vec3> results(vector_count);
+
+    std::cout << "# sizeof(Real)=" << sizeof(Real) << " sizeof(Vec3)=" << sizeof(Vec3)
+        << " alignof(Vec3)=" << alignof(Vec3) << '\n';
+    std::cout << "operation,ns_per_op,checksum\n";
+    measure("add", [&](const size_t i){
+        results[i] = a[i] + b[i];
+        return results[i].x();
+    });
+    measure("scale_add", [&](const size_t i){
+        results[i] = a[i] + static_cast<Real>(0.5) * b[i];
+        return results[i].y();
+    });
+    measure("dot", [&](const size_t i){
+        return a[i].dot(b[i]);
+    });
+    measure("cross", [&](const size_t i){
+        results[i] = a[i].cross(b[i]);
+        return results[i].z();
+    });
+    measure("unit_vector", [&](const size_t i){
+        results[i] = a[i].unit_vector();
+        return results[i].x();
+    });
+    measure("reflect", [&](const size_t i){
+        results[i] = a[i].reflect(b[i]);
+        return results[i].x();
+    });
+    measure("ray_at", [&](const size_t i){
+        results[i] = Ray(a[i], b[i]).at(static_cast<Real>(i));
+        return results[i].y();
+    });
+    measure("random_unit_vector", [&](const size_t i){
+        results[i] = Vec3::random_unit_vector();
+        return results[i].z();
+    });
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Ray.hpp"
+#include "Interval.hpp"
+
+/// @brief Axis-aligned bounding box, stored as its minimum and maximum corner.
+struct AABB{
+    Point3 minimum, maximum;
+
+    /// The default box is empty, so that merging anything into it yields that thing.
+    inline constexpr AABB() noexcept
+        : minimum(INFINITY, INFINITY, INFINITY), maximum(-INFINITY, -INFINITY, -INFINITY) {}
+    inline constexpr AABB(const Point3& min_corner, const Point3& max_corner) noexcept
+        : minimum(min_corner), maximum(max_corner) {}
+
+    /// @brief Returns the smallest box that encloses both boxes. std::min and std::max compile
+    /// to single instructions, where std::fmin and std::fmax are library calls for their NaN
+    /// handling, which matters to BVH builds over millions of boxes. Boxes never hold NaN.
+    inline AABB merge(const AABB& other) const noexcept {
+        return AABB(
+            Point3(std::min(minimum.x(), other.minimum.x()), std::min(minimum.y(), other.minimum.y()),
+                std::min(minimum.z(), other.minimum.z())),
+            Point3(std::max(maximum.x(), other.maximum.x()), std::max(maximum.y(), other.maximum.y()),
+                std::max(maximum.z(), other.maximum.z()))
+        );
+    }
+
+    /// @brief Returns the smallest box that encloses the box and the point.
+    inline AABB merge(const Point3& point) const noexcept {
+        return merge(AABB(point, point));
+    }
+
+    inline Point3 centroid() const noexcept {
+        return 0.5 * (minimum + maximum);
+    }
+
+    /// @brief Returns the index of the axis along which the box is the longest.
+    inline int longest_axis() const noexcept {
+        const Vec3 extent = maximum - minimum;
+        if(extent.x() > extent.y()){
+            return extent.x() > extent.z()? 0 : 2;
+        }
+        return extent.y() > extent.z()? 1 : 2;
+    }
+
+    /// @brief Returns the surface area of the box, 0 for an empty box.
+    inline double surface_area() const noexcept {
+        const Vec3 extent = maximum - minimum;
+        if(extent.x() < 0 || extent.y() < 0 || extent.z() < 0){
+            return 0;
+        }
+        return 2 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+    }
+
+    /// @brief Slab test against a ray, given the reciprocal of the ray direction.
+    /// Returns whether the ray overlaps the box within the interval. The exit distances are
+    /// rounded up past the error of their computation (Ize 2013), so a ray touching only a
+    /// corner or an edge of the box, like a ray through a mesh vertex, isn't culled.
+    inline bool hit(const Ray& ray, const Vec3& inverse_direction, const Interval ray_time) const noexcept {
+        static constexpr double exit_scale = 1 + 4 * std::numeric_limits<double>::epsilon();
+        double t_min = ray_time.min, t_max = ray_time.max;
+        for(int axis = 0;axis < 3;axis++){
+            const double t0 = (minimum[axis] - ray.origin()[axis]) * inverse_direction[axis];
+            const double t1 = (maximum[axis] - ray.origin()[axis]) * inverse_direction[axis];
+            t_min = std::max(t_min, std::min(t0, t1));
+            t_max = std::min(t_max, std::max(t0, t1) * exit_scale);
+        }
+        return t_min <= t_max;
+    }
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BVH.hpp"
+#include "EncodingThread.hpp"
+#include "Scene.hpp"
+
+// Animations are read from a text file with one statement per line, `#` starts a comment:
+//   frames <count>
+//   keyframe <look_from x y z> <look_at x y z>   keyframes are spread evenly over the frames
+//   move <sphere index> <velocity x y z>        the velocity is in units per frame
+//   rebuild_threshold <factor>
+
+/// @brief Camera position at a point of an animation.
+struct CameraKeyframe{
+    Point3 look_from, look_at;
+};
+
+/// @brief Sphere moving at a constant velocity, in units per frame.
+struct SphereMotion{
+    uint32_t sphere;
+    Vec3 velocity;
+};
+
+/// @brief Camera path and sphere motions of an animation of a scene.
+struct Animation{
+    uint32_t frame_count = 1;
+    std::vector<CameraKeyframe> keyframes; // Without keyframes the camera of the scene stays put
+    std::vector<SphereMotion> motions;
+    double rebuild_threshold = 1.5; // Rebuild the BVH once refitting raised its cost by this factor
+
+    /// @brief Returns the camera of a frame, interpolating linearly between the keyframes.
+    inline CameraParameters camera(CameraParameters parameters, const uint32_t frame) const noexcept {
+        if(keyframes.empty()){
+            return parameters;
+        }
+        const double position = frame_count > 1?
+            static_cast<double>(frame) / (frame_count - 1) * (keyframes.size() - 1) : 0;
+        const size_t first = std::min(static_cast<size_t>(position), keyframes.size() - 1);
+        const size_t second = std::min(first + 1, keyframes.size() - 1);
+        const double blend = position - first;
+        parameters.look_from = (1 - blend) * keyframes[first].look_from + blend * keyframes[second].look_from;
+        parameters.look_at = (1 - blend) * keyframes[first].look_at + blend * keyframes[second].look_at;
+        return parameters;
+    }
+};
+
+/// @brief Reads an animation, error describes the first problem if it fails.
+inline bool load_animation(std::istream& in, Animation& animation, std::string& error) {
+    std::string line;
+    for(size_t line_number = 1;std::getline(in, line);line_number++){
+        std::istringstream statement(line.substr(0, line.find('#')));
+        std::string keyword;
+        if(!(statement >> keyword)){
+            continue;
+        }
+
+        double values[6];
+        bool valid;
+        if(keyword == "frames"){
+            valid = static_cast<bool>(statement >> animation.frame_count) && animation.frame_count > 0;
+        }else if(keyword == "keyframe"){
+            valid = static_cast<bool>(statement >> values[0] >> values[1] >> values[2] >> values[3]
+                >> values[4] >> values[5]);
+            animation.keyframes.push_back(CameraKeyframe{
+                Point3(values[0], values[1], values[2]), Point3(values[3], values[4], values[5])});
+        }else if(keyword == "move"){
+            uint32_t sphere = 0;
+            valid = static_cast<bool>(statement >> sphere >> values[0] >> values[1] >> values[2]);
+            animation.motions.push_back(SphereMotion{sphere, Vec3(values[0], values[1], values[2])});
+        }else if(keyword == "rebuild_threshold"){
+            valid = static_cast<bool>(statement >> animation.rebuild_threshold);
+        }else{
+            error = "line " + std::to_string(line_number) + ": unknown statement " + keyword;
+            return false;
+        }
+        if(!valid){
+            error = "line " + std::to_string(line_number) + ": invalid " + keyword;
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Returns the path of a frame's image: the pattern with its first run of '#'
+/// replaced by the zero-padded frame number, or with the number appended if it has none.
+inline std::string frame_path(const std::string& pattern, const uint32_t frame) {
+    const size_t start = pattern.find('#');
+    std::string number = std::to_string(frame);
+    if(start == std::string::npos){
+        return pattern + number;
+    }
+    const size_t end = std::min(pattern.find_first_not_of('#', start), pattern.size());
+    if(number.size() < end - start){
+        number.insert(0, end - start - number.size(), '0');
+    }
+    return pattern.substr(0, start) + number + pattern.substr(end);
+}
+
+/// @brief Renders every frame of the animation into the files named by the output pattern.
+/// The scene, its materials and its BVH are reused across the frames. When spheres move, the
+/// BVH is refitted instead of rebuilt, unless that made it too slow to traverse. A frame is
+/// encoded and written while the next one renders. Returns whether every frame could be
+/// written, error names the files that couldn't.
+inline bool render_animation(Scene& scene, const Animation& animation, const RenderSettings& settings,
+    const std::string& output_pattern, std::string& error) {
+    std::vector<Point3> start_centers;
+    for(const SphereMotion& motion : animation.motions){
+        start_centers.push_back(scene.spheres.geometry.center(motion.sphere));
+    }
+
+    EncodingThread encoder(settings.format);
+    std::optional<BVH> bvh;
+    double built_cost = 0;
+    for(uint32_t frame = 0;frame < animation.frame_count;frame++){
+        for(size_t i = 0;i < animation.motions.size();i++){
+            scene.spheres.move(animation.motions[i].sphere, start_centers[i] + frame * animation.motions[i].velocity);
+        }
+
+        const HittableList world = scene.world();
+        if(bvh && !animation.motions.empty()){
+            bvh->refit(world);
+        }
+        if(!bvh || bvh->cost() > animation.rebuild_threshold * built_cost){
+            bvh.emplace(world);
+            built_cost = bvh->cost();
+        }
+
+        RenderSettings frame_settings = settings;
+        frame_settings.frame = settings.frame + frame;
+        std::clog << "Frame " << frame + 1 << " of " << animation.frame_count << '\n';
+        const Camera camera = animation.camera(scene.camera, frame).camera();
+        Framebuffer image(0, 0);
+        dispatch_scene(settings.dispatch, *bvh, scene.materials, [&](const auto& world, const auto& materials){
+            image = camera.render_image(world, materials, frame_settings);
+            if(settings.denoise_iterations > 0){
+                image = denoise(image, camera.render_features(world, materials, frame_settings), frame_settings);
+            }
+        });
+        encoder.submit(std::move(image), frame_path(output_pattern, frame));
+    }
+    return encoder.finish(error);
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// @brief Monotonic allocator: hands out memory from large blocks by bumping an offset, and
+/// frees all of it at once when destroyed, running the destructors of the objects that need it
+/// in reverse order of construction. Rewinding to a mark makes the memory allocated since then
+/// available again but keeps the blocks, so an arena reused for the same work stops allocating
+/// from the heap after the first round.
+class MonotonicArena{
+public:
+    /// @brief Position in the arena to rewind to.
+    struct Mark{
+        size_t block, offset, destructors;
+    };
+private:
+    static constexpr size_t max_block_size = size_t(1) << 26;
+
+    struct Block{
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+
+    struct Destructor{
+        void* object;
+        void (*destroy)(void* object);
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;   // Block the next allocation is tried in
+    size_t offset = 0;    // Bytes used in the current block
+    size_t next_block_size; // Doubles with every new block, up to max_block_size
+    std::vector<Destructor> destructors;
+public:
+    inline explicit MonotonicArena(const size_t first_block_size = 4096) noexcept
+        : next_block_size(std::max<size_t>(first_block_size, 64)) {}
+
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    // Moving keeps the blocks, so objects in the arena stay where they are
+    inline MonotonicArena(MonotonicArena&& other) noexcept
+        : blocks(std::move(other.blocks)), current(other.current), offset(other.offset),
+        next_block_size(other.next_block_size), destructors(std::move(other.destructors)) {
+        other.current = other.offset = 0;
+    }
+
+    inline MonotonicArena& operator=(MonotonicArena&& other) noexcept {
+        if(this != &other){
+            reset();
+            blocks = std::move(other.blocks);
+            current = other.current;
+            offset = other.offset;
+            next_block_size = other.next_block_size;
+            destructors = std::move(other.destructors);
+            other.current = other.offset = 0;
+        }
+        return *this;
+    }
+
+    inline ~MonotonicArena() noexcept {
+        reset();
+    }
+
+    /// @brief Returns `size` bytes aligned to `alignment`, a power of two.
+    inline void* allocate(const size_t size, const size_t alignment = alignof(std::max_align_t)) {
+        while(true){
+            if(current < blocks.size()){
+                const uintptr_t base = reinterpret_cast<uintptr_t>(blocks[current].memory.get());
+                const size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+                if(start + size <= blocks[current].size){
+                    offset = start + size;
+                    return blocks[current].memory.get() + start;
+                }
+                // Blocks kept from before a rewind may be too small, the request moves on to the next
+                if(current + 1 < blocks.size() || offset > 0){
+                    current++;
+                    offset = 0;
+                    continue;
+                }
+            }
+            const size_t block_size = std::max(next_block_size, size + alignment);
+            blocks.insert(blocks.begin() + static_cast<std::ptrdiff_t>(std::min(current, blocks.size())),
+                Block{std::make_unique<std::byte[]>(block_size), block_size});
+            current = std::min(current, blocks.size() - 1);
+            offset = 0;
+            next_block_size = std::min(next_block_size * 2, max_block_size);
+        }
+    }
+
+    /// @brief Constructs an object in the arena, its destructor runs when the arena is reset.
+    template<typename T, typename... Args>
+    inline T& create(Args&&... args) {
+        T* const object = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if constexpr(!std::is_trivially_destructible_v<T>){
+            destructors.push_back(Destructor{object, [](void* const pointer){
+                static_cast<T*>(pointer)->~T();
+            }});
+        }
+        return *object;
+    }
+
+    /// @brief Returns `count` value-initialized elements.
+    template<typename T>
+    inline T* allocate_array(const size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "arrays in an arena are never destroyed");
+        T* const elements = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+        std::uninitialized_value_construct_n(elements, count);
+        return elements;
+    }
+
+    inline Mark mark() const noexcept {
+        return Mark{current, offset, destructors.size()};
+    }
+
+    /// @brief Destroys the objects created since the mark and makes their memory available again.
+    inline void rewind(const Mark& position) noexcept {
+        while(destructors.size() > position.destructors){
+            destructors.back().destroy(destructors.back().object);
+            destructors.pop_back();
+        }
+        current = position.block;
+        offset = position.offset;
+    }
+
+    /// @brief Destroys all objects, keeping the blocks for reuse.
+    inline void reset() noexcept {
+        rewind(Mark{0, 0, 0});
+    }
+
+    /// @brief Returns the bytes of all blocks.
+    inline size_t capacity() const noexcept {
+        size_t total = 0;
+        for(const Block& block : blocks){
+            total += block.size;
+        }
+        return total;
+    }
+};
+
+/// @brief Rewinds an arena to where it was when the scope began, when the scope ends.
+class ArenaScope{
+private:
+    MonotonicArena& arena;
+    const MonotonicArena::Mark start;
+public:
+    inline explicit ArenaScope(MonotonicArena& scoped_arena) noexcept
+        : arena(scoped_arena), start(scoped_arena.mark()) {}
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    inline ~ArenaScope() noexcept {
+        arena.rewind(start);
+    }
+};
+
+/// @brief Returns the calling thread's arena for temporary buffers, like the per-tile buffers
+/// of the render loop. Allocate from it inside an ArenaScope, so the memory is reused.
+inline MonotonicArena& thread_scratch() noexcept {
+    thread_local MonotonicArena arena(size_t(1) << 20);
+    return arena;
+}
@@ -0,0 +1,378 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AABB.hpp"
+#include "Hittable.hpp"
+#include "HittableList.hpp"
+#include "RenderStats.hpp"
+
+/// @brief Node of a flattened bounding volume hierarchy, sized to fill one cache line.
+/// The nodes are stored depth first, so the first child of an interior node directly follows it.
+struct alignas(64) BVHNode{
+    AABB bounds;
+    uint32_t offset; // Leaf: first primitive, interior node: index of the second child
+    uint16_t count;  // Number of primitives in a leaf, 0 for interior nodes
+    uint8_t axis;    // Axis the children of an interior node are split along
+};
+
+/// @brief Bounding volume hierarchy over a set of bounding boxes, built with binned SAH.
+/// The tree only knows the boxes, the caller intersects the primitives in the leaves.
+struct BVHTree{
+    static constexpr uint8_t bin_count = 16;       // Candidate split planes per axis
+    static constexpr uint16_t max_leaf_size = 4;   // Largest leaf the SAH is allowed to keep
+    static constexpr uint8_t max_sah_depth = 64;   // Deeper nodes are split in half instead
+    static constexpr uint8_t stack_capacity = 96;  // Halving adds at most 32 levels below the SAH limit
+    static constexpr double traversal_cost = 0.125; // Cost of visiting a node relative to a primitive test
+
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> primitives; // Indices of the input boxes in leaf order
+
+private:
+    // The centroid is recomputed from the box when needed, a smaller reference means less
+    // memory traffic in the passes over large ranges
+    struct Reference{
+        AABB bounds;
+        uint32_t index;
+    };
+
+    inline void make_leaf(const uint32_t node, const std::vector<Reference>& references,
+        const size_t begin, const size_t end) {
+        nodes[node].offset = static_cast<uint32_t>(primitives.size());
+        nodes[node].count = static_cast<uint16_t>(end - begin);
+        for(size_t i = begin;i < end;i++){
+            primitives.push_back(references[i].index);
+        }
+    }
+
+    inline uint32_t build(std::vector<Reference>& references, const size_t begin, const size_t end,
+        const uint8_t depth) {
+        const uint32_t node = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+
+        AABB bounds, centroid_bounds;
+        for(size_t i = begin;i < end;i++){
+            bounds = bounds.merge(references[i].bounds);
+            centroid_bounds = centroid_bounds.merge(references[i].bounds.centroid());
+        }
+        nodes[node].bounds = bounds;
+
+        const size_t count = end - begin;
+        if(count == 1){
+            make_leaf(node, references, begin, end);
+            return node;
+        }
+
+        // Bin the references along all axes in one pass over the range
+        std::array<double, 3> axis_mins, scales;
+        std::array<bool, 3> binned;
+        for(int axis = 0;axis < 3;axis++){
+            axis_mins[axis] = centroid_bounds.minimum[axis];
+            const double extent = centroid_bounds.maximum[axis] - axis_mins[axis];
+            binned[axis] = extent > 0;
+            scales[axis] = binned[axis]? bin_count / extent : 0;
+        }
+        std::array<std::array<AABB, bin_count>, 3> bin_bounds;
+        std::array<std::array<size_t, bin_count>, 3> bin_counts{};
+        for(size_t i = begin;i < end;i++){
+            const Point3 centroid = references[i].bounds.centroid();
+            for(int axis = 0;axis < 3;axis++){
+                if(binned[axis]){
+                    const size_t bin = std::min<size_t>(bin_count - 1,
+                        static_cast<size_t>((centroid[axis] - axis_mins[axis]) * scales[axis]));
+                    bin_counts[axis][bin]++;
+                    bin_bounds[axis][bin] = bin_bounds[axis][bin].merge(references[i].bounds);
+                }
+            }
+        }
+
+        // Evaluate the surface area heuristic at the bin boundaries of every axis
+        double best_cost = INFINITY;
+        int best_axis = -1;
+        uint8_t best_split = 0;
+        for(int axis = 0;axis < 3;axis++){
+            if(!binned[axis]){
+                continue;
+            }
+
+            // Sweep from the right to get the cost of everything right of each split plane
+            std::array<double, bin_count> right_costs{};
+            AABB right_bounds;
+            size_t right_count = 0;
+            for(uint8_t split = bin_count - 1;split > 0;split--){
+                right_bounds = right_bounds.merge(bin_bounds[axis][split]);
+                right_count += bin_counts[axis][split];
+                right_costs[split] = right_bounds.surface_area() * right_count;
+            }
+
+            AABB left_bounds;
+            size_t left_count = 0;
+            for(uint8_t split = 1;split < bin_count;split++){
+                left_bounds = left_bounds.merge(bin_bounds[axis][split - 1]);
+                left_count += bin_counts[axis][split - 1];
+                const double cost = left_bounds.surface_area() * left_count + right_costs[split];
+                if(left_count > 0 && left_count < count && cost < best_cost){
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = split;
+                }
+            }
+        }
+
+        const double area = bounds.surface_area();
+        best_cost = traversal_cost + (area > 0? best_cost / area : best_cost);
+        if(count <= max_leaf_size && (best_axis < 0 || best_cost >= count)){
+            make_leaf(node, references, begin, end);
+            return node;
+        }
+
+        size_t middle;
+        if(best_axis >= 0 && depth < max_sah_depth){
+            const double axis_min = axis_mins[best_axis], scale = scales[best_axis];
+            middle = std::partition(references.begin() + begin, references.begin() + end,
+                [&](const Reference& reference){
+                    return std::min<size_t>(bin_count - 1, static_cast<size_t>(
+                        (reference.bounds.centroid()[best_axis] - axis_min) * scale)) < best_split;
+                }) - references.begin();
+            nodes[node].axis = static_cast<uint8_t>(best_axis);
+        }else{
+            // All centroids coincide (or the tree got too deep), split the range in half
+            middle = begin + count / 2;
+            const int axis = centroid_bounds.longest_axis();
+            std::nth_element(references.begin() + begin, references.begin() + middle,
+                references.begin() + end, [axis](const Reference& a, const Reference& b){
+                    return a.bounds.centroid()[axis] < b.bounds.centroid()[axis];
+                });
+            nodes[node].axis = static_cast<uint8_t>(axis);
+        }
+
+        build(references, begin, middle, depth + 1);
+        const uint32_t second_child = build(references, middle, end, depth + 1);
+        nodes[node].offset = second_child;
+        nodes[node].count = 0;
+        return node;
+    }
+public:
+    inline BVHTree() {}
+
+    /// @brief Builds the tree over the boxes, which are released before the build, as the
+    /// references copy them.
+    inline explicit BVHTree(std::vector<AABB> bounds) {
+        if(bounds.empty()){
+            return;
+        }
+        std::vector<Reference> references;
+        references.reserve(bounds.size());
+        for(uint32_t i = 0;i < bounds.size();i++){
+            references.push_back(Reference{bounds[i], i});
+        }
+        bounds = std::vector<AABB>();
+        nodes.reserve(2 * references.size());
+        primitives.reserve(references.size());
+        build(references, 0, references.size(), 0);
+        nodes.shrink_to_fit();
+    }
+
+    /// @brief Recomputes the bounds of every node for new boxes of the primitives, keeping the
+    /// structure of the tree. Much cheaper than a rebuild, but the tree gets slower to traverse
+    /// the further the primitives moved since it was built.
+    inline void refit(const std::vector<AABB>& bounds) noexcept {
+        // Children follow their parent, so going backwards visits them first
+        for(size_t node = nodes.size();node-- > 0;){
+            AABB node_bounds;
+            if(nodes[node].count > 0){
+                for(uint32_t i = nodes[node].offset;i < nodes[node].offset + nodes[node].count;i++){
+                    node_bounds = node_bounds.merge(bounds[primitives[i]]);
+                }
+            }else{
+                node_bounds = nodes[node + 1].bounds.merge(nodes[nodes[node].offset].bounds);
+            }
+            nodes[node].bounds = node_bounds;
+        }
+    }
+
+    /// @brief Returns the expected cost of a ray query according to the surface area heuristic,
+    /// in primitive tests. Compare it before and after a refit to see how much the tree degraded.
+    inline double cost() const noexcept {
+        if(nodes.empty()){
+            return 0;
+        }
+        double total = 0;
+        for(const BVHNode& node : nodes){
+            total += node.bounds.surface_area() * (node.count > 0? node.count : traversal_cost);
+        }
+        const double root_area = nodes.front().bounds.surface_area();
+        return root_area > 0? total / root_area : total;
+    }
+
+    /// @brief Visits the leaves the ray passes through, nearest child first.
+    /// `leaf_hit(begin, end, interval, closest)` tests the primitives at positions [begin, end)
+    /// of `primitives`, and lowers `closest` to the nearest of them hit within the interval.
+    template<typename LeafHit>
+    inline bool traverse(const Ray& ray, const Interval ray_time, LeafHit&& leaf_hit) const {
+        if(nodes.empty()){
+            return false;
+        }
+        const Vec3 inverse_direction(
+            1 / ray.direction().x(), 1 / ray.direction().y(), 1 / ray.direction().z());
+        const std::array<bool, 3> direction_negative{
+            inverse_direction.x() < 0, inverse_direction.y() < 0, inverse_direction.z() < 0};
+
+        std::array<uint32_t, stack_capacity> stack;
+        size_t stack_size = 0;
+        uint32_t current = 0;
+        double closest = ray_time.max;
+        bool hit_anything = false;
+        while(true){
+            const BVHNode& node = nodes[current];
+            RAY_TRACER_STAT(thread_stats().node_visits++);
+            if(node.bounds.hit(ray, inverse_direction, Interval(ray_time.min, closest))){
+                if(node.count == 0){
+                    // Descend into the child on the side the ray comes from first
+                    if(direction_negative[node.axis]){
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }else{
+                        stack[stack_size++] = node.offset;
+                        current++;
+                    }
+                    continue;
+                }
+                if(leaf_hit(node.offset, node.offset + node.count, Interval(ray_time.min, closest), closest)){
+                    hit_anything = true;
+                }
+            }
+            if(stack_size == 0){
+                break;
+            }
+            current = stack[--stack_size];
+        }
+        return hit_anything;
+    }
+};
+
+/// @brief Hittable that accelerates ray queries against the contents of a HittableList.
+/// The spheres of the list are copied into the BVH's own storage in leaf order, with the
+/// spheres of a leaf ahead of its other objects, so the spheres of every leaf are consecutive
+/// and tested together by the packet kernels.
+class BVH final : public Hittable {
+private:
+    static constexpr uint32_t object_flag = 1u << 31; // Marks items that refer to `objects`
+
+    SphereStorage spheres;                // Spheres of the list, in leaf order
+    std::vector<const Hittable*> objects; // Other objects of the list, in leaf order
+    std::vector<uint32_t> items;          // Sphere or flagged object index for every leaf position
+    BVHTree tree;
+
+    /// @brief Returns the boxes of the spheres and then the other objects of the list.
+    static inline std::vector<AABB> primitive_bounds(const HittableList& list) {
+        std::vector<AABB> bounds;
+        bounds.reserve(list.sphere_end - list.sphere_begin + list.objects.size());
+        for(uint32_t i = list.sphere_begin;i < list.sphere_end;i++){
+            bounds.push_back(list.spheres->bounding_box(i));
+        }
+        for(const Hittable* object : list.objects){
+            bounds.push_back(object->bounding_box());
+        }
+        return bounds;
+    }
+public:
+    inline explicit BVH(const HittableList& list) {
+        const uint32_t sphere_count = list.sphere_end - list.sphere_begin;
+        tree = BVHTree(primitive_bounds(list));
+        for(const BVHNode& node : tree.nodes){
+            if(node.count > 0){
+                std::stable_partition(tree.primitives.begin() + node.offset,
+                    tree.primitives.begin() + node.offset + node.count,
+                    [sphere_count](const uint32_t primitive){ return primitive < sphere_count; });
+            }
+        }
+
+        spheres.reserve(sphere_count);
+        items.reserve(tree.primitives.size());
+        for(const uint32_t primitive : tree.primitives){
+            if(primitive < sphere_count){
+                const uint32_t source = list.sphere_begin + primitive;
+                items.push_back(spheres.add(list.spheres->geometry.center(source),
+                    list.spheres->geometry.radius[source], list.spheres->materials[source]));
+            }else{
+                items.push_back(static_cast<uint32_t>(objects.size()) | object_flag);
+                objects.push_back(list.objects[primitive - sphere_count]);
+            }
+        }
+    }
+
+    /// @brief Updates the BVH after the spheres or objects of the list it was built from moved.
+    /// The list must hold the same primitives in the same order as when the BVH was built.
+    inline void refit(const HittableList& list) {
+        const uint32_t sphere_count = list.sphere_end - list.sphere_begin;
+        for(uint32_t position = 0;position < items.size();position++){
+            const uint32_t primitive = tree.primitives[position];
+            if(primitive < sphere_count){
+                spheres.move(items[position], list.spheres->geometry.center(list.sphere_begin + primitive));
+                spheres.geometry.radius[items[position]] = list.spheres->geometry.radius[list.sphere_begin + primitive];
+            }
+        }
+        tree.refit(primitive_bounds(list));
+    }
+
+    /// @brief Returns the expected cost of a ray query, see BVHTree::cost.
+    inline double cost() const noexcept {
+        return tree.cost();
+    }
+
+    /// @brief Finds the nearest hit. The traversal only tracks the time and the item of the
+    /// nearest hit so far, the point, normal and material of a sphere hit are resolved once,
+    /// for the final one.
+    inline bool hit(const Ray& ray, const Interval ray_time, HitRecord& record) const override {
+        uint32_t nearest_item = 0;
+        double nearest_time = ray_time.max;
+        HitRecord object_record; // Nearest hit among the objects other than spheres
+        const bool hit_anything = tree.traverse(ray, ray_time,
+            [&](const uint32_t begin, const uint32_t end, const Interval interval, double& closest){
+                bool leaf_hit = false;
+                uint32_t position = begin;
+                while(position < end && (items[position] & object_flag) == 0){
+                    position++;
+                }
+                if(position > begin){
+                    const SphereHit sphere_hit = nearest_sphere_hit_leaf(
+                        spheres.geometry, ray, interval, items[begin], items[position - 1] + 1);
+                    if(sphere_hit.index != SphereHit::no_hit){
+                        closest = sphere_hit.time;
+                        nearest_item = sphere_hit.index;
+                        leaf_hit = true;
+                    }
+                }
+                for(;position < end;position++){
+                    HitRecord temp_record;
+                    if(objects[items[position] & ~object_flag]->hit(
+                        ray, Interval(interval.min, closest), temp_record)){
+                        object_record = temp_record;
+                        closest = temp_record.time;
+                        nearest_item = items[position];
+                        leaf_hit = true;
+                    }
+                }
+                nearest_time = closest;
+                return leaf_hit;
+            });
+        if(!hit_anything){
+            return false;
+        }
+        if((nearest_item & object_flag) == 0){
+            spheres.fill_record(ray, nearest_item, nearest_time, record);
+        }else{
+            record = object_record;
+        }
+        return true;
+    }
+
+    inline AABB bounding_box() const override {
+        return tree.nodes.empty()? AABB() : tree.nodes.front().bounds;
+    }
+};
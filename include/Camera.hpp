@@ -3,22 +3,37 @@
 #include "Hittable.hpp"
 #include "Color.hpp"
 #include "util.hpp"
-#include "Material.hpp"
+#include "MaterialTable.hpp"
+#include "Framebuffer.hpp"
+#include "RenderSettings.hpp"
+#include "ThreadPool.hpp"
+#include "PathBatch.hpp"
+#include "EncodingThread.hpp"
+#include "RenderStats.hpp"
+#include "Shard.hpp"
+#include "Denoiser.hpp"
+#include "Arena.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cinttypes>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
 
 class Camera{
 private:
-    uint16_t image_height;            // Rendered image height
+    uint32_t image_height;            // Rendered image height
     Point3 camera_center;             // Camera center
     Point3 pixel_origin_location;     // Location of pixel 0, 0
     Vec3 pixel_delta_u;               // Offset to pixel to the right
     Vec3 pixel_delta_v;               // Offset to pixel below
     double aspect_ratio;              // Ratio of image width and height
-    uint16_t image_width;             // Rendered image width in pixel count
+    uint32_t image_width;             // Rendered image width in pixel count
     const uint16_t samples_per_pixel;  // Count of random samples for each pixel
-    const double pixel_samples_scale; // Color scale factor for a sum of pixel samples.
     const uint8_t max_depth;          // Maximum number of ray bounces into scene
     const double vfov;                // Vertical view angle (field of view)
     const Point3 look_from;           // Point camera is looking from
@@ -32,7 +47,7 @@ private:
 public:
     inline Camera(
         const double aspect = 1.0,
-        const uint16_t width = 100,
+        const uint32_t width = 100,
         const uint16_t samples = 10,
         const uint8_t depth_limit = 10,
         const double fov = 90,
@@ -42,13 +57,13 @@ public:
         const double defocus_angle_value = 0,
         const double focus_distance = 10
     ) noexcept
-        : samples_per_pixel(samples), pixel_samples_scale(1.0 / samples), max_depth(depth_limit),
+        : samples_per_pixel(samples), max_depth(depth_limit),
         vfov(fov), look_from(camera_position), look_at(camera_target), vector_up(up_direction),
         defocus_angle(defocus_angle_value), focus_dist(focus_distance) {
         // Calculate the image dimensions
         aspect_ratio = aspect;
         image_width = width;
-        image_height = static_cast<uint16_t>(std::fmax(image_width / aspect_ratio, 1));
+        image_height = static_cast<uint32_t>(std::clamp(image_width / aspect_ratio, 1.0, static_cast<double>(UINT32_MAX)));
 
         // Camera properties
         // Viewport width less than one are ok since they are real values
@@ -82,66 +97,645 @@ public:
         defocus_disk_v = v * defocus_radius;
     }
 
-    inline Color ray_color(const Ray& ray, const uint8_t depth_left, const Hittable& world) const noexcept {
+    /// @brief Returns the light a ray collects, following it for at most `depth_left` bounces.
+    /// `throughput` is the attenuation the path gathered before the ray, Russian roulette
+    /// ends the path early when it gets small.
+    template<typename World, typename Materials>
+    inline Color ray_color(const Ray& ray, const uint8_t depth_left, const World& world,
+        const Materials& materials, Sampler& sampler, const RenderSettings& settings,
+        const Color& throughput = Color(1, 1, 1)) const noexcept {
         // If the ray bounce limit is reached, no more light is gathered
         if(depth_left == 0){
+            RAY_TRACER_STAT(thread_stats().path_lengths[max_depth]++);
             return Color(0, 0, 0);
         }
 
+        depth_left == max_depth? thread_stats().primary_rays++ : thread_stats().secondary_rays++;
         HitRecord record;
         if(world.hit(ray, Interval(0.001, INFINITY), record)){
             Ray scattered;
             Color attenuation;
-            if(record.material->scatter(ray, record, attenuation, scattered)){
-                return attenuation * ray_color(scattered, depth_left - 1, world);
+            RAY_TRACER_STAT(thread_stats().count_material_hit(materials.type_of(record.material)));
+            if(materials[record.material].scatter(ray, record, attenuation, scattered, sampler)){
+                const uint8_t bounces = max_depth - depth_left + 1;
+                const Color path_throughput = throughput * attenuation;
+                const double weight = roulette_weight(path_throughput, bounces, settings, sampler);
+                if(weight == 0){
+                    RAY_TRACER_STAT(thread_stats().roulette_terminations++);
+                    RAY_TRACER_STAT(thread_stats().path_lengths[bounces]++);
+                    return Color(0, 0, 0);
+                }
+                return weight * attenuation * ray_color(scattered, depth_left - 1, world, materials, sampler, settings,
+                    path_throughput * weight);
             }
+            RAY_TRACER_STAT(thread_stats().path_lengths[max_depth - depth_left + 1]++);
             return Color(0, 0, 0);
         }
 
+        RAY_TRACER_STAT(thread_stats().path_lengths[max_depth - depth_left]++);
+        return background(ray);
+    }
+
+    /// @brief Russian roulette: once a path made roulette_depth bounces, it continues with a
+    /// probability proportional to its throughput, so paths that can't contribute much end
+    /// early. Returns the factor to scale the throughput of a surviving path by, which keeps the
+    /// estimate unbiased, and 0 for a path that ends.
+    inline double roulette_weight(const Color& throughput, const uint8_t bounces, const RenderSettings& settings,
+        Sampler& sampler) const noexcept {
+        if(settings.roulette_depth == 0 || bounces < settings.roulette_depth){
+            return 1;
+        }
+        const double survival = std::clamp<Real>(std::max({std::fabs(throughput.x()), std::fabs(throughput.y()),
+            std::fabs(throughput.z())}), Real(0.05), Real(1));
+        if(survival == 1){
+            return 1;
+        }
+        return sampler.next_1d() < survival? 1 / survival : 0;
+    }
+
+    /// @brief Returns the light a ray that leaves the scene collects from the sky.
+    inline Color background(const Ray& ray) const noexcept {
         const Vec3 unit_direction = ray.direction().unit_vector();
         const double a = 0.5 * (unit_direction.y() + 1.0);
         return (1.0 - a) * Color(1, 1, 1) + a * Color(0.5, 0.7, 1);
     }
 
     /// Returns the vector to a random point in the [-.5, -.5]-[.5, .5] unit square.
-    inline Vec3 sample_square() const {
-        return Vec3(random_double() - 0.5, random_double() - 0.5, 0);
+    inline Vec3 sample_square(Sampler& sampler) const noexcept {
+        const SamplePoint point = sampler.next_2d();
+        return Vec3(point.u - 0.5, point.v - 0.5, 0);
     }
 
     /// @brief Returns a random point in the camera defocus disk
-    inline Point3 defocus_disk_sample() const {
-        const Point3 point = Point3::random_in_unit_disk();
+    inline Point3 defocus_disk_sample(Sampler& sampler) const noexcept {
+        const Point3 point = sampler.in_unit_disk();
         return camera_center + point[0] * defocus_disk_u + point[1] * defocus_disk_v;
     }
 
     /// Constructs a camera ray originating from the defocus disk and directed at a randomly
     /// sampled point around the pixel location x, y
-    inline Ray get_ray(const int32_t x, const int32_t y) const {
-        const Vec3 offset = sample_square();
+    inline Ray get_ray(const uint32_t x, const uint32_t y, Sampler& sampler) const noexcept {
+        const Vec3 offset = sample_square(sampler);
         const Point3 pixel_sample = pixel_origin_location
             + (x + offset.x()) * pixel_delta_u
             + (y + offset.y()) * pixel_delta_v;
 
-        const Point3 ray_origin = defocus_angle <= 0? camera_center : defocus_disk_sample();
+        const Point3 ray_origin = defocus_angle <= 0? camera_center : defocus_disk_sample(sampler);
         const Vec3 ray_direction = pixel_sample - ray_origin;
 
         return Ray(ray_origin, ray_direction);
     }
 
-    inline void render(const Hittable& world) const {
-        // Render the image
-        std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
-        for(uint16_t y = 0;y < image_height;y++){
-            for(uint16_t x = 0;x < image_width;x++){
-                std::clog << '\r' << (image_height - y) << " lines remaining " << (image_width - x) << " pixels remaining ";
-                Color pixel_color(0, 0, 0);
-                for(uint16_t sample = 0;sample < samples_per_pixel;sample++){
-                    const Ray ray = get_ray(x, y);
-                    pixel_color += ray_color(ray, max_depth, world);
+    /// @brief Returns the sampler of one sample of a pixel.
+    inline Sampler pixel_sampler(const RenderSettings& settings, const uint32_t x, const uint32_t y,
+        const uint16_t sample) const noexcept {
+        return Sampler(settings.sample_pattern, settings.seed, settings.frame, x, y,
+            static_cast<uint64_t>(y) * image_width + x, sample, samples_per_pixel);
+    }
+
+    /// @brief Width and height of the rendered image in pixels.
+    inline uint32_t width() const noexcept {
+        return image_width;
+    }
+
+    inline uint32_t height() const noexcept {
+        return image_height;
+    }
+
+    /// @brief Pixel range [x_start, x_end) x [y_start, y_end) covered by a tile.
+    struct TileBounds{
+        uint32_t x_start, y_start, x_end, y_end;
+
+        inline uint32_t width() const noexcept {
+            return x_end - x_start;
+        }
+
+        inline uint32_t pixel_count() const noexcept {
+            return width() * (y_end - y_start);
+        }
+    };
+
+    inline size_t tile_columns(const RenderSettings& settings) const noexcept {
+        return (static_cast<size_t>(image_width) + settings.tile_size - 1) / settings.tile_size;
+    }
+
+    inline size_t tile_rows(const RenderSettings& settings) const noexcept {
+        return (static_cast<size_t>(image_height) + settings.tile_size - 1) / settings.tile_size;
+    }
+
+    inline TileBounds tile_bounds(const size_t tile, const RenderSettings& settings) const noexcept {
+        const size_t tiles_x = tile_columns(settings);
+        const size_t x_start = tile % tiles_x * settings.tile_size;
+        const size_t y_start = tile / tiles_x * settings.tile_size;
+        return TileBounds{
+            static_cast<uint32_t>(x_start), static_cast<uint32_t>(y_start),
+            static_cast<uint32_t>(std::min<size_t>(image_width, x_start + settings.tile_size)),
+            static_cast<uint32_t>(std::min<size_t>(image_height, y_start + settings.tile_size))
+        };
+    }
+
+    /// @brief Returns the range [first, second) of the tiles of the settings that lie in the
+    /// rows [first_row, first_row + row_count), first_row being the first row of a tile.
+    inline std::pair<size_t, size_t> tile_range(const RenderSettings& settings, const uint32_t first_row,
+        const uint32_t row_count) const noexcept {
+        const size_t tiles_x = tile_columns(settings);
+        const size_t begin = std::max<size_t>(settings.tile_begin, first_row / settings.tile_size * tiles_x);
+        const size_t end = std::min<size_t>(settings.tile_end,
+            (static_cast<size_t>(first_row) + row_count + settings.tile_size - 1) / settings.tile_size * tiles_x);
+        return {begin, std::max(begin, end)};
+    }
+
+    /// @brief Renders the pixels of one tile into the framebuffer, tracing every sample
+    /// recursively with ray_color.
+    /// Every sample draws from its own sampler, derived from the seed, frame, pixel and sample
+    /// index, so the result doesn't depend on how or in which order the work is scheduled.
+    template<typename World, typename Materials>
+    inline void render_tile(
+        const World& world, const Materials& materials, Framebuffer& image, const RenderSettings& settings,
+        const size_t tile) const {
+        const TileBounds bounds = tile_bounds(tile, settings);
+        const uint16_t sample_begin = std::min(settings.sample_begin, samples_per_pixel);
+        const uint16_t sample_end = std::min(settings.sample_end, samples_per_pixel);
+
+        for(uint32_t y = bounds.y_start;y < bounds.y_end;y++){
+            for(uint32_t x = bounds.x_start;x < bounds.x_end;x++){
+                ColorSum pixel_sum;
+                uint16_t count;
+                if(settings.adaptive){
+                    count = sample_pixel_adaptive(world, materials, settings, x, y, pixel_sum);
+                }else{
+                    // Continue from the samples already in the framebuffer
+                    const size_t index = image.index(x, y);
+                    pixel_sum = image.sums[index];
+                    uint16_t sample = sample_begin + image.sample_counts[index];
+                    for(;sample < sample_end;sample++){
+                        Sampler sampler = pixel_sampler(settings, x, y, sample);
+                        const Ray ray = get_ray(x, y, sampler);
+                        pixel_sum.add(ray_color(ray, max_depth, world, materials, sampler, settings));
+                    }
+                    count = sample - sample_begin;
+                }
+                image.set_samples(x, y, pixel_sum, count);
+            }
+        }
+    }
+
+    /// @brief Samples a pixel until the mean of its luminance is known precisely enough.
+    /// Tracks the running mean and variance of the sample luminance (Welford's algorithm),
+    /// adds the samples to `pixel_sum` and returns how many were taken.
+    template<typename World, typename Materials>
+    inline uint16_t sample_pixel_adaptive(
+        const World& world, const Materials& materials, const RenderSettings& settings,
+        const uint32_t x, const uint32_t y, ColorSum& pixel_sum) const {
+        const uint16_t min_samples = std::min(settings.min_samples, samples_per_pixel);
+        double mean = 0, squared_deviations = 0;
+        uint16_t sample = 0;
+        while(sample < samples_per_pixel){
+            Sampler sampler = pixel_sampler(settings, x, y, sample);
+            const Ray ray = get_ray(x, y, sampler);
+            const Color sample_color = ray_color(ray, max_depth, world, materials, sampler, settings);
+            pixel_sum.add(sample_color);
+            sample++;
+
+            const double luminance = 0.2126 * sample_color.x() + 0.7152 * sample_color.y()
+                + 0.0722 * sample_color.z();
+            const double delta = luminance - mean;
+            mean += delta / sample;
+            squared_deviations += delta * (luminance - mean);
+
+            if(sample >= min_samples && sample > 1){
+                const double variance = squared_deviations / (sample - 1);
+                if(1.96 * std::sqrt(variance / sample) < settings.noise_threshold){
+                    break;
+                }
+            }
+        }
+        return sample;
+    }
+
+    /// @brief Renders the pixels of one tile into the framebuffer with the wavefront integrator.
+    /// All samples of the tile are traced as batches of paths, one bounce at a time: generate
+    /// camera rays, intersect them all, group the hits by material type, scatter every group
+    /// and compact the paths that are still alive. Converges to the same image as render_tile.
+    template<typename World, typename Materials>
+    inline void render_tile_wavefront(
+        const World& world, const Materials& materials, Framebuffer& image, const RenderSettings& settings,
+        const size_t tile) const {
+        const TileBounds bounds = tile_bounds(tile, settings);
+        const uint16_t sample_begin = std::min(settings.sample_begin, samples_per_pixel);
+        const uint16_t sample_end = std::min(settings.sample_end, samples_per_pixel);
+
+        // Pixels continue from the samples already in the framebuffer. Samples
+        // [first_samples[pixel], sample_end) of a pixel are traced by the paths starting at
+        // path_offsets[pixel]. The buffers live in the thread's scratch arena.
+        MonotonicArena& scratch = thread_scratch();
+        const ArenaScope scope(scratch);
+        const uint32_t pixel_count = bounds.pixel_count();
+        ColorSum* const accumulated = scratch.allocate_array<ColorSum>(pixel_count);
+        uint16_t* const first_samples = scratch.allocate_array<uint16_t>(pixel_count);
+        size_t* const path_offsets = scratch.allocate_array<size_t>(pixel_count + 1);
+        for(uint32_t pixel = 0;pixel < pixel_count;pixel++){
+            const size_t index = image.index(bounds.x_start + pixel % bounds.width(),
+                bounds.y_start + pixel / bounds.width());
+            accumulated[pixel] = image.sums[index];
+            first_samples[pixel] = sample_begin + image.sample_counts[index];
+            path_offsets[pixel + 1] = path_offsets[pixel] + std::max(sample_end, first_samples[pixel])
+                - first_samples[pixel];
+        }
+        const size_t path_count = path_offsets[pixel_count];
+        const size_t batch_size = std::min<size_t>(path_count, settings.wavefront_batch_size);
+
+        thread_local PathBatch batch;
+        batch.resize(batch_size);
+
+        uint32_t pixel = 0;
+        for(size_t first = 0;first < path_count;first += batch_size){
+            // Generate the camera rays
+            const size_t count = std::min(batch_size, path_count - first);
+            batch.active.clear();
+            for(uint32_t path = 0;path < count;path++){
+                while(path_offsets[pixel + 1] <= first + path){
+                    pixel++;
+                }
+                const uint16_t sample = static_cast<uint16_t>(first_samples[pixel] + (first + path - path_offsets[pixel]));
+                const uint32_t x = bounds.x_start + pixel % bounds.width();
+                const uint32_t y = bounds.y_start + pixel / bounds.width();
+                batch.samplers[path] = pixel_sampler(settings, x, y, sample);
+                batch.rays[path] = get_ray(x, y, batch.samplers[path]);
+                batch.throughput[path] = Color(1, 1, 1);
+                batch.pixels[path] = pixel;
+                batch.active.push_back(path);
+            }
+
+            for(uint8_t depth = 0;depth < max_depth && !batch.active.empty();depth++){
+                // Intersect, paths leaving the scene collect the sky and end
+                batch.type_offsets.assign(materials.type_count() + 1, 0);
+                size_t remaining = 0;
+                (depth == 0? thread_stats().primary_rays : thread_stats().secondary_rays) += batch.active.size();
+                for(const uint32_t path : batch.active){
+                    if(world.hit(batch.rays[path], Interval(0.001, INFINITY), batch.hits[path])){
+                        batch.type_offsets[materials.type_of(batch.hits[path].material) + 1]++;
+                        batch.active[remaining++] = path;
+                    }else{
+                        RAY_TRACER_STAT(thread_stats().path_lengths[depth]++);
+                        accumulated[batch.pixels[path]].add(
+                            batch.throughput[path] * background(batch.rays[path]));
+                    }
+                }
+                batch.active.resize(remaining);
+
+                // Group the hits by material type with a counting sort
+                for(size_t type = 1;type < batch.type_offsets.size();type++){
+                    batch.type_offsets[type] += batch.type_offsets[type - 1];
+                }
+                for(const uint32_t path : batch.active){
+                    batch.grouped[batch.type_offsets[materials.type_of(batch.hits[path].material)]++] = path;
+                }
+
+                // Scatter every group and compact the paths that continue
+                remaining = 0;
+                for(size_t i = 0;i < batch.active.size();i++){
+                    const uint32_t path = batch.grouped[i];
+                    Ray scattered;
+                    Color attenuation;
+                    RAY_TRACER_STAT(thread_stats().count_material_hit(materials.type_of(batch.hits[path].material)));
+                    if(materials[batch.hits[path].material].scatter(
+                        batch.rays[path], batch.hits[path], attenuation, scattered, batch.samplers[path])){
+                        batch.throughput[path] *= attenuation;
+                        const double weight = roulette_weight(batch.throughput[path], depth + 1, settings,
+                            batch.samplers[path]);
+                        if(weight == 0){
+                            RAY_TRACER_STAT(thread_stats().roulette_terminations++);
+                            RAY_TRACER_STAT(thread_stats().path_lengths[depth + 1]++);
+                            continue;
+                        }
+                        batch.throughput[path] *= weight;
+                        batch.rays[path] = scattered;
+                        batch.active[remaining++] = path;
+                    }else{
+                        RAY_TRACER_STAT(thread_stats().path_lengths[depth + 1]++);
+                    }
+                }
+                batch.active.resize(remaining);
+            }
+            RAY_TRACER_STAT(thread_stats().path_lengths[max_depth] += batch.active.size());
+        }
+
+        for(pixel = 0;pixel < pixel_count;pixel++){
+            const uint32_t x = bounds.x_start + pixel % bounds.width();
+            const uint32_t y = bounds.y_start + pixel / bounds.width();
+            image.set_samples(x, y, accumulated[pixel], std::max(sample_end, first_samples[pixel]) - sample_begin);
+        }
+    }
+
+    /// @brief Renders the tiles of the settings that lie in the rows of `image`, the whole image
+    /// or a band of whole tiles, distributing them over a work-stealing thread pool. Adds the
+    /// statistics of the tiles to `total`, and their times to its tile_seconds if it has room
+    /// for every tile of the image. The progress report counts `tiles_after` tiles to come.
+    template<typename World, typename Materials>
+    inline void render_tiles(const World& world, const Materials& materials, Framebuffer& image,
+        const RenderSettings& settings, RenderStats& total, const size_t tiles_after = 0) const {
+        const auto [tile_begin, tile_end] = tile_range(settings, image.first_row, image.height);
+
+        // Report the progress at most every progress_interval, not for every tile
+        using clock = std::chrono::steady_clock;
+        std::atomic<size_t> tiles_left(tile_end - tile_begin + tiles_after);
+        std::mutex log_mutex;
+        clock::time_point next_report = clock::now();
+        const SharedThreadPool pool = shared_thread_pool(settings.thread_count);
+        std::vector<RenderStats> worker_stats(pool->size());
+
+        // The checkpoint holds the finished tiles and the start of the others. Every finished
+        // tile is copied into it, as the other tiles may be halfway done at any time.
+        const bool checkpointing = !settings.checkpoint_path.empty();
+        Framebuffer checkpoint = checkpointing? image : Framebuffer(0, 0);
+        const ShardHeader checkpoint_header(image, settings, samples_per_pixel);
+        std::mutex checkpoint_mutex;
+        clock::time_point next_checkpoint = clock::now() + settings.checkpoint_interval;
+        pool->run(tile_end - tile_begin, [&](const size_t task, const size_t worker){
+            const size_t tile = tile_begin + task;
+            const clock::time_point tile_start = clock::now();
+            thread_stats() = RenderStats();
+            if(settings.integrator == Integrator::Wavefront){
+                render_tile_wavefront(world, materials, image, settings, tile);
+            }else{
+                render_tile(world, materials, image, settings, tile);
+            }
+            worker_stats[worker].merge(thread_stats());
+            if(tile < total.tile_seconds.size()){
+                total.tile_seconds[tile] = std::chrono::duration<double>(clock::now() - tile_start).count();
+            }
+
+            if(checkpointing){
+                const std::lock_guard<std::mutex> lock(checkpoint_mutex);
+                const TileBounds bounds = tile_bounds(tile, settings);
+                for(uint32_t y = bounds.y_start;y < bounds.y_end;y++){
+                    for(size_t index = image.index(bounds.x_start, y);index < image.index(bounds.x_end, y);index++){
+                        checkpoint.sums[index] = image.sums[index];
+                        checkpoint.sample_counts[index] = image.sample_counts[index];
+                    }
                 }
-                write_color(std::cout, pixel_samples_scale * pixel_color);
+                if(clock::now() >= next_checkpoint){
+                    if(!save_shard_file(settings.checkpoint_path, checkpoint, checkpoint_header)){
+                        std::clog << "\nCan't write the checkpoint " << settings.checkpoint_path << '\n';
+                    }
+                    next_checkpoint = clock::now() + settings.checkpoint_interval;
+                }
+            }
+
+            const size_t left = --tiles_left;
+            const std::unique_lock<std::mutex> lock(log_mutex, std::try_to_lock);
+            if(lock.owns_lock() && clock::now() >= next_report){
+                next_report = clock::now() + settings.progress_interval;
+                std::clog << '\r' << left << " tiles remaining " << std::flush;
             }
+        });
+        for(const RenderStats& worker : worker_stats){
+            total.merge(worker);
+        }
+    }
+
+    /// @brief Prints the mean samples per pixel an adaptive render took.
+    static inline void print_sample_count(const uint64_t samples, const uint64_t pixels) {
+        std::clog << samples << " samples, " << static_cast<double>(samples) / pixels << " per pixel\n";
+    }
+
+    static inline uint64_t sample_count(const Framebuffer& image) noexcept {
+        uint64_t samples = 0;
+        for(const uint16_t count : image.sample_counts){
+            samples += count;
+        }
+        return samples;
+    }
+
+    /// @brief Returns whether a render of this camera can continue from the checkpoint: it must
+    /// have the image size, and at most the samples per pixel of the camera.
+    inline bool can_resume(const Framebuffer& checkpoint, const ShardHeader& header, std::string& error) const {
+        if(checkpoint.width != image_width || checkpoint.height != image_height){
+            error = "the checkpoint is " + std::to_string(checkpoint.width) + "x" + std::to_string(checkpoint.height)
+                + " pixels, the render " + std::to_string(image_width) + "x" + std::to_string(image_height);
+            return false;
+        }
+        if(header.samples_per_pixel > samples_per_pixel){
+            error = "the checkpoint is of a render of " + std::to_string(header.samples_per_pixel)
+                + " samples per pixel, more than " + std::to_string(samples_per_pixel);
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Renders the image into a framebuffer, splitting it into tiles that are
+    /// distributed over a work-stealing thread pool. Prints a summary of the render when done,
+    /// and returns the statistics it is based on through `stats` if given.
+    /// Pixels continue from the samples in `resume_from` if given, usually loaded from a
+    /// checkpoint, which must have the image size, see can_resume.
+    /// The render is instantiated for the types of the world and the materials. With a final
+    /// class like BVH and a BuiltinMaterialTable, hits and scatters are direct calls the compiler
+    /// can inline, with Hittable and MaterialTable they are virtual calls, which work for any
+    /// object and material type. See dispatch_scene.
+    template<typename World, typename Materials>
+    inline Framebuffer render_image(const World& world, const Materials& materials,
+        const RenderSettings& settings = {}, RenderStats* const stats = nullptr,
+        const Framebuffer* const resume_from = nullptr) const {
+        Framebuffer image = resume_from != nullptr? *resume_from : Framebuffer(image_width, image_height);
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        RenderStats total;
+        total.tile_seconds.resize(tile_columns(settings) * tile_rows(settings));
+        render_tiles(world, materials, image, settings, total);
+        std::clog << "\nDone.\n";
+        if(!settings.checkpoint_path.empty() && !save_shard_file(settings.checkpoint_path, image,
+            ShardHeader(image, settings, samples_per_pixel))){
+            std::clog << "Can't write the checkpoint " << settings.checkpoint_path << '\n';
+        }
+
+        total.print(std::clog, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+            max_depth, materials.type_names());
+        if(stats != nullptr){
+            *stats = std::move(total);
+        }
+        if(settings.adaptive){
+            print_sample_count(sample_count(image), image.sample_counts.size());
+        }
+        return image;
+    }
+
+    /// @brief Renders the image band by band, see RenderSettings::band_rows, and writes every
+    /// band to `out` in the format of the settings as soon as it is done, the bands from the top
+    /// down or, for formats storing the rows bottom up, from the bottom up. The pixels are the
+    /// same as render_image's, as they don't depend on the order they are rendered in. Only
+    /// one band is in memory, tile times aren't kept, as they grow with the image.
+    template<typename World, typename Materials>
+    inline void render_streamed(const World& world, const Materials& materials, const RenderSettings& settings,
+        std::ostream& out) const {
+        const std::unique_ptr<ImageEncoder> encoder = make_encoder(settings.format);
+        const uint64_t band_rows = std::max<uint64_t>(1,
+            (static_cast<uint64_t>(settings.band_rows) + settings.tile_size - 1) / settings.tile_size) * settings.tile_size;
+        const uint64_t band_count = (image_height + band_rows - 1) / band_rows;
+        const auto [tile_begin, tile_end] = tile_range(settings, 0, image_height);
+        size_t tiles_after = tile_end - tile_begin;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        RenderStats total;
+        uint64_t samples = 0;
+        encoder->begin(out, image_width, image_height);
+        for(uint64_t i = 0;i < band_count;i++){
+            const uint64_t band = encoder->bottom_up()? band_count - 1 - i : i;
+            const uint32_t first_row = static_cast<uint32_t>(band * band_rows);
+            Framebuffer image(image_width, static_cast<uint32_t>(std::min<uint64_t>(band_rows,
+                image_height - first_row)), first_row);
+            const auto [band_begin, band_end] = tile_range(settings, image.first_row, image.height);
+            tiles_after -= band_end - band_begin;
+            render_tiles(world, materials, image, settings, total, tiles_after);
+            encoder->write_band(out, image);
+            samples += sample_count(image);
         }
+        encoder->finish(out);
+        out.flush();
         std::clog << "\nDone.\n";
+
+        total.print(std::clog, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+            max_depth, materials.type_names());
+        if(settings.adaptive){
+            print_sample_count(samples, static_cast<uint64_t>(image_width) * image_height);
+        }
+    }
+
+    /// @brief Traces the camera rays of the first feature_samples samples of every pixel to
+    /// their first hit and averages what they hit, see FeatureBuffers. These are the rays the
+    /// image starts its samples with, so the features line up with the edges in the image.
+    /// Rays follow specular surfaces to what they show, with the attenuation of the surfaces
+    /// in the albedo, so the denoiser keeps the edges in reflections and refractions.
+    template<typename World, typename Materials>
+    inline FeatureBuffers render_features(const World& world, const Materials& materials,
+        const RenderSettings& settings = {}) const {
+        FeatureBuffers features(image_width, image_height);
+        const uint16_t samples = std::clamp<uint16_t>(settings.feature_samples, 1, samples_per_pixel);
+        const SharedThreadPool pool = shared_thread_pool(settings.thread_count);
+        pool->run(image_height, [&](const size_t row, size_t){
+            const uint32_t y = static_cast<uint32_t>(row);
+            for(uint32_t x = 0;x < image_width;x++){
+                Color albedo(0, 0, 0);
+                Vec3 normal(0, 0, 0);
+                double depth = 0;
+                for(uint16_t sample = 0;sample < samples;sample++){
+                    Sampler sampler = pixel_sampler(settings, x, y, sample);
+                    Ray ray = get_ray(x, y, sampler);
+                    Color weight(1, 1, 1);
+                    double distance = 0;
+                    HitRecord record;
+                    bool surface = false;
+                    for(uint8_t depth_left = max_depth;depth_left > 0 && !surface;depth_left--){
+                        if(!world.hit(ray, Interval(0.001, INFINITY), record)){
+                            break;
+                        }
+                        const auto& material = materials[record.material];
+                        distance += record.time * ray.direction().length();
+                        Color attenuation;
+                        Ray scattered;
+                        surface = !material.specular() || depth_left == 1 ||
+                            !material.scatter(ray, record, attenuation, scattered, sampler);
+                        if(surface){
+                            albedo += weight * material.base_color();
+                            normal += record.normal;
+                            depth += distance;
+                        }else{
+                            weight *= attenuation;
+                            ray = scattered;
+                        }
+                    }
+                    if(!surface){
+                        albedo += weight * background(ray);
+                    }
+                }
+                const size_t index = static_cast<size_t>(y) * image_width + x;
+                features.albedo[index] = albedo / samples;
+                features.normal[index] = normal / samples;
+                features.depth[index] = depth / samples;
+            }
+        });
+        return features;
+    }
+
+    /// @brief Returns an image of the time spent on every tile, from blue for the fastest
+    /// to red for the slowest tile.
+    inline Framebuffer tile_time_map(const std::vector<double>& tile_seconds,
+        const RenderSettings& settings) const {
+        Framebuffer map(image_width, image_height);
+        const auto [fastest, slowest] = std::minmax_element(tile_seconds.begin(), tile_seconds.end());
+        const double range = std::max(*slowest - *fastest, 1e-12);
+        for(size_t tile = 0;tile < tile_seconds.size();tile++){
+            // Squared, to cancel out the gamma correction of the encoders
+            const double heat = (tile_seconds[tile] - *fastest) / range;
+            const Color color(heat * heat, 0, (1 - heat) * (1 - heat));
+            const TileBounds bounds = tile_bounds(tile, settings);
+            for(uint32_t y = bounds.y_start;y < bounds.y_end;y++){
+                for(uint32_t x = bounds.x_start;x < bounds.x_end;x++){
+                    map.at(x, y) = color;
+                }
+            }
+        }
+        return map;
+    }
+
+    /// @brief Renders the image and writes it to standard output in the format of the settings,
+    /// or to the shard file of the settings if it has one. Continues from `resume_from` if given.
+    /// With band_rows in the settings, the image is streamed to standard output instead, see
+    /// render_streamed. Returns whether the image and every other file could be written.
+    template<typename World, typename Materials>
+    inline bool render(const World& world, const Materials& materials,
+        const RenderSettings& settings = {}, const Framebuffer* const resume_from = nullptr) const {
+        if(settings.band_rows > 0){
+            render_streamed(world, materials, settings, std::cout);
+            if(!std::cout.flush()){
+                std::clog << "Can't write the image to standard output\n";
+                return false;
+            }
+            return true;
+        }
+        EncodingThread encoder(settings.format);
+        RenderStats stats;
+        Framebuffer image = render_image(world, materials, settings, &stats, resume_from);
+        const bool denoising = settings.denoise_iterations > 0 && settings.shard_path.empty();
+        if(denoising || !settings.albedo_path.empty() || !settings.normal_path.empty() ||
+            !settings.depth_path.empty()){
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            const FeatureBuffers features = render_features(world, materials, settings);
+            if(!settings.albedo_path.empty()){
+                encoder.submit(features.albedo_image(), settings.albedo_path);
+            }
+            if(!settings.normal_path.empty()){
+                encoder.submit(features.normal_image(), settings.normal_path);
+            }
+            if(!settings.depth_path.empty()){
+                encoder.submit(features.depth_image(), settings.depth_path);
+            }
+            if(denoising){
+                image = denoise(image, features, settings);
+            }
+            std::clog << (denoising? "Features and denoising took " : "Features took ") << std::chrono::duration<
+                double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+        }
+        if(!settings.sample_map_path.empty()){
+            encoder.submit(image.sample_count_map(), settings.sample_map_path);
+        }
+        if(!settings.tile_heat_map_path.empty()){
+            encoder.submit(tile_time_map(stats.tile_seconds, settings), settings.tile_heat_map_path);
+        }
+        bool written = true;
+        if(!settings.shard_path.empty()){
+            if(!save_shard_file(settings.shard_path, image, ShardHeader(image, settings, samples_per_pixel))){
+                std::clog << "Can't write the shard " << settings.shard_path << '\n';
+                written = false;
+            }
+        }else{
+            encoder.submit(std::move(image), std::cout, "standard output");
+        }
+        std::string error;
+        if(!encoder.finish(error)){
+            std::clog << error << '\n';
+            written = false;
+        }
+        return written;
     }
 };
@@ -1,19 +1,68 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 #include "Vec3.hpp"
 #include "Interval.hpp"
 
 using Color = Vec3;
 
+/// @brief Sum of sample colors in 64-bit fixed point. Integer addition is associative, so
+/// adding up the samples of a pixel in any grouping or order, like over several processes,
+/// gives exactly the same bits.
+struct ColorSum{
+    static constexpr double scale = 1ull << 40; // Leaves room for 65535 samples of up to 128
+    static constexpr double max_component = 128;
+
+    int64_t red = 0, green = 0, blue = 0;
+
+    /// @brief Converts a component to fixed point. Components are clamped to
+    /// +-max_component, so no sum can overflow, and NaN counts as 0.
+    static inline int64_t fixed_point(const double component) noexcept {
+        if(std::isnan(component)){
+            return 0;
+        }
+        return std::llround(std::clamp(component, -max_component, max_component) * scale);
+    }
+
+    inline void add(const Color& color) noexcept {
+        red += fixed_point(color.x());
+        green += fixed_point(color.y());
+        blue += fixed_point(color.z());
+    }
+
+    inline void add(const ColorSum& other) noexcept {
+        red += other.red;
+        green += other.green;
+        blue += other.blue;
+    }
+
+    /// @brief Returns the mean of the `count` added colors, black for no colors.
+    inline Color mean(const uint16_t count) const noexcept {
+        if(count == 0){
+            return Color(0, 0, 0);
+        }
+        const double factor = 1 / (scale * count);
+        return Color(red * factor, green * factor, blue * factor);
+    }
+};
+
 inline double linear_to_gamma(const double linear_component){
     return linear_component > 0? std::sqrt(linear_component) : 0;
 }
 
-inline std::ostream& write_color(std::ostream& out, const Color& pixel_color){
+/// @brief Converts a linear color component to a gamma corrected byte.
+inline uint8_t component_to_byte(const double linear_component){
     static const Interval intensity(0, 0.999);
-    const uint16_t red = static_cast<uint8_t>(256 *  intensity.clamp(linear_to_gamma(pixel_color.x())));
-    const uint16_t green = static_cast<uint8_t>(256 * intensity.clamp(linear_to_gamma(pixel_color.y())));
-    const uint16_t blue = static_cast<uint8_t>(256 * intensity.clamp(linear_to_gamma(pixel_color.z())));
+    return static_cast<uint8_t>(256 * intensity.clamp(linear_to_gamma(linear_component)));
+}
+
+inline std::ostream& write_color(std::ostream& out, const Color& pixel_color){
+    const uint16_t red = component_to_byte(pixel_color.x());
+    const uint16_t green = component_to_byte(pixel_color.y());
+    const uint16_t blue = component_to_byte(pixel_color.z());
 
     out << red << ' ' << green << ' ' << blue << '\n';
     return out;
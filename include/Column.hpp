@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/// @brief Contiguous array of trivially copyable elements that either owns its elements or
+/// views memory owned elsewhere, like a memory-mapped scene file. Reading is the same in both
+/// cases, appending to a view first copies the viewed elements.
+template<typename T>
+class Column{
+private:
+    std::vector<T> owned;     // Elements, unless this column is a view
+    const T* values = nullptr; // First element, in `owned` or in the viewed memory
+    size_t count = 0;
+
+    inline bool is_view() const noexcept {
+        return values != owned.data();
+    }
+
+    inline void own() {
+        if(is_view()){
+            owned.assign(values, values + count);
+            values = owned.data();
+        }
+    }
+public:
+    inline Column() noexcept {}
+
+    /// @brief Returns a column viewing `size` elements at `data`, which must outlive it.
+    static inline Column view(const T* const data, const size_t size) noexcept {
+        Column column;
+        column.values = data;
+        column.count = size;
+        return column;
+    }
+
+    inline Column(const Column& other)
+        : owned(other.owned), values(other.is_view()? other.values : owned.data()), count(other.count) {}
+
+    // Moving a vector keeps its buffer, so `values` stays valid
+    inline Column(Column&& other) noexcept
+        : owned(std::move(other.owned)), values(other.values), count(other.count) {
+        other.values = nullptr;
+        other.count = 0;
+    }
+
+    inline Column& operator=(Column other) noexcept {
+        std::swap(owned, other.owned);
+        std::swap(values, other.values);
+        std::swap(count, other.count);
+        return *this;
+    }
+
+    inline size_t size() const noexcept {
+        return count;
+    }
+
+    inline const T* data() const noexcept {
+        return values;
+    }
+
+    inline const T& operator[](const size_t index) const noexcept {
+        return values[index];
+    }
+
+    /// @brief Returns a modifiable element, a view copies the viewed elements first.
+    inline T& operator[](const size_t index) {
+        own();
+        return owned[index];
+    }
+
+    inline void reserve(const size_t capacity) {
+        own();
+        owned.reserve(capacity);
+        values = owned.data();
+    }
+
+    inline void push_back(const T& value) {
+        own();
+        owned.push_back(value);
+        values = owned.data();
+        count++;
+    }
+};
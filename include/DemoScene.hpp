@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Scene.hpp"
+#include "util.hpp"
+
+/// @brief Builds the final scene of "Ray Tracing in One Weekend": a large ground sphere,
+/// a grid of about 480 small random spheres and three large ones.
+/// The random layout is drawn from the calling thread's random stream.
+inline Scene demo_scene() {
+    Scene scene;
+    const uint32_t ground_material = scene.add_material<Lambertian>(Color(0.5, 0.5, 0.5));
+    scene.add_sphere(Point3(0, -1000, 0), 1000, ground_material);
+
+    for(int8_t a = -11;a < 11;a++){
+        for(int8_t b = -11;b < 11;b++){
+            const double choose_mat = random_double();
+            const Point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+            if((center - Point3(4, 0.2, 0)).length() > 0.9){
+                uint32_t sphere_material;
+
+                if(choose_mat < 0.8){
+                    // Diffuse
+                    const Color albedo = Color::random() * Color::random();
+                    sphere_material = scene.add_material<Lambertian>(albedo);
+                    scene.add_sphere(center, 0.2, sphere_material);
+                }else if(choose_mat < 0.95){
+                    // Metal
+                    const Color albedo = Color::random(0.5, 1);
+                    const double fuzz = random_double(0, 0.5);
+                    sphere_material = scene.add_material<Metal>(albedo, fuzz);
+                    scene.add_sphere(center, 0.2, sphere_material);
+                }else{
+                    // Glass
+                    sphere_material = scene.add_material<Dielectric>(1.5);
+                    scene.add_sphere(center, 0.2, sphere_material);
+                }
+            }
+        }
+    }
+
+    const uint32_t material1 = scene.add_material<Dielectric>(1.5);
+    scene.add_sphere(Point3(0, 1, 0), 1.0, material1);
+
+    const uint32_t material2 = scene.add_material<Lambertian>(Color(0.4, 0.2, 0.1));
+    scene.add_sphere(Point3(-4, 1, 0), 1.0, material2);
+
+    const uint32_t material3 = scene.add_material<Metal>(Color(0.7, 0.6, 0.5), 0);
+    scene.add_sphere(Point3(4, 1, 0), 1, material3);
+
+    return scene;
+}
+
+/// @brief Returns the camera the demo scene is rendered with.
+inline Camera demo_camera(const uint32_t width = 1200, const uint16_t samples = 500,
+    const uint8_t max_depth = 50) {
+    CameraParameters parameters;
+    parameters.image_width = width;
+    parameters.samples_per_pixel = samples;
+    parameters.max_depth = max_depth;
+    return parameters.camera();
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Color.hpp"
+#include "Framebuffer.hpp"
+#include "RenderSettings.hpp"
+#include "SpherePacket.hpp"
+#include "ThreadPool.hpp"
+
+/// @brief What the camera rays of every pixel hit first, averaged over the rays: the base color
+/// of the surface, its normal, facing the camera, and its distance from the camera. Pixels
+/// showing the sky have the color of the sky as albedo, a zero normal and zero depth.
+struct FeatureBuffers{
+    uint32_t width, height;
+    std::vector<Color> albedo; // Row-major, starting at the upper left pixel
+    std::vector<Vec3> normal;  // In the same order
+    std::vector<double> depth; // In the same order
+
+    inline FeatureBuffers(const uint32_t image_width, const uint32_t image_height)
+        : width(image_width), height(image_height), albedo(static_cast<size_t>(image_width) * image_height),
+        normal(albedo.size()), depth(albedo.size()) {}
+
+    // The images hold the raw values, only PFM keeps the negative normal components and
+    // depths above 1
+    inline Framebuffer albedo_image() const {
+        Framebuffer image(width, height);
+        image.pixels = albedo;
+        return image;
+    }
+
+    inline Framebuffer normal_image() const {
+        Framebuffer image(width, height);
+        image.pixels.assign(normal.begin(), normal.end());
+        return image;
+    }
+
+    inline Framebuffer depth_image() const {
+        Framebuffer image(width, height);
+        for(size_t i = 0;i < depth.size();i++){
+            image.pixels[i] = Color(depth[i], depth[i], depth[i]);
+        }
+        return image;
+    }
+};
+
+/// @brief Returns e^x for x <= 0 with a relative error below 1e-12. Unlike std::exp it only
+/// adds and multiplies, so the loops calling it vectorize and give the same bits at any
+/// vector width: a Taylor polynomial of e^(x/1024), squared ten times. Arguments below -64
+/// give e^-64, no weight that small matters next to the weight of the filtered pixel itself.
+/// They are clamped with fabs, as the compiler keeps loops with a conditional scalar.
+inline double exp_nonpositive(const double x) noexcept {
+    const double above_min = x + 64; // y + |y| is exactly 0 for y < 0, whatever its magnitude
+    const double r = ((above_min + std::fabs(above_min)) * 0.5 - 64) * (1.0 / 1024);
+    double power = 1 + r * (1 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120
+        + r * (1.0 / 720 + r * (1.0 / 5040 + r * (1.0 / 40320))))))));
+    power *= power; // Squared one by one rather than in a loop, which would keep the callers' loops scalar
+    power *= power;
+    power *= power;
+    power *= power;
+    power *= power;
+    power *= power;
+    power *= power;
+    power *= power;
+    power *= power;
+    power *= power;
+    return power;
+}
+
+/// @brief The image and features the denoiser works on in structure-of-arrays layout, one
+/// plane per component, so the filter can apply a tap to a row of pixels in vector lanes.
+struct DenoisePlanes{
+    static constexpr double min_albedo = 0.01;
+
+    int64_t width, height;
+    std::vector<double> albedo[3], normal[3], depth;     // Features
+    std::vector<double> lighting[3], luminance, variance; // Lighting, the image divided by the albedo
+    std::vector<double> filtered[3], filtered_variance;   // Output of a filter pass
+
+    inline DenoisePlanes(const Framebuffer& image, const FeatureBuffers& features)
+        : width(image.width), height(image.height), depth(features.depth), luminance(image.pixels.size()),
+        variance(image.pixels.size()), filtered_variance(image.pixels.size()) {
+        for(uint8_t axis = 0;axis < 3;axis++){
+            albedo[axis].resize(image.pixels.size());
+            normal[axis].resize(image.pixels.size());
+            lighting[axis].resize(image.pixels.size());
+            filtered[axis].resize(image.pixels.size());
+            for(size_t i = 0;i < image.pixels.size();i++){
+                albedo[axis][i] = features.albedo[i][axis];
+                normal[axis][i] = features.normal[i][axis];
+                lighting[axis][i] = image.pixels[i][axis] / std::max<double>(albedo[axis][i], min_albedo);
+            }
+        }
+        update_luminance();
+    }
+
+    inline void update_luminance() noexcept {
+        for(size_t i = 0;i < luminance.size();i++){
+            luminance[i] = 0.2126 * lighting[0][i] + 0.7152 * lighting[1][i] + 0.0722 * lighting[2][i];
+        }
+    }
+
+    /// @brief Makes the output of a filter pass the input of the next one.
+    inline void swap_filtered() noexcept {
+        for(uint8_t axis = 0;axis < 3;axis++){
+            std::swap(lighting[axis], filtered[axis]);
+        }
+        std::swap(variance, filtered_variance);
+        update_luminance();
+    }
+};
+
+/// @brief Returns how much the features of two pixels differ, as the exponent of the factor
+/// the denoiser weights one of them by when filtering the other. depth_scale is the inverse of
+/// the depth difference that counts as much as a completely different normal.
+inline double feature_distance(const DenoisePlanes& planes, const size_t pixel, const size_t other,
+    const double depth_scale) noexcept {
+    static constexpr double albedo_sigma = 0.1;
+    static constexpr double normal_sigma = 0.3;
+    const double albedo_x = planes.albedo[0][other] - planes.albedo[0][pixel];
+    const double albedo_y = planes.albedo[1][other] - planes.albedo[1][pixel];
+    const double albedo_z = planes.albedo[2][other] - planes.albedo[2][pixel];
+    const double normal_x = planes.normal[0][other] - planes.normal[0][pixel];
+    const double normal_y = planes.normal[1][other] - planes.normal[1][pixel];
+    const double normal_z = planes.normal[2][other] - planes.normal[2][pixel];
+    const double depth_difference = (planes.depth[other] - planes.depth[pixel]) * depth_scale;
+    return (albedo_x * albedo_x + albedo_y * albedo_y + albedo_z * albedo_z) / (albedo_sigma * albedo_sigma)
+        + (normal_x * normal_x + normal_y * normal_y + normal_z * normal_z) / (normal_sigma * normal_sigma)
+        + depth_difference * depth_difference;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RAY_TRACER_ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define RAY_TRACER_ALWAYS_INLINE
+#endif
+
+static constexpr double denoise_depth_sigma = 0.02; // Relative depth difference per pixel of distance
+static constexpr int64_t denoise_block = 64;        // Pixels of a row the taps are applied to at a time
+
+/// @brief Estimates the noise of the pixels of row y: the variance of the luminance of the
+/// lighting of the 3x3 pixels around each of them, weighted by how much their features match.
+/// Every tap is applied to a block of the row before the next one, accumulating into arrays on
+/// the stack that can't alias the planes, so the loops over the pixels vectorize. Inlined into
+/// the kernels of every instruction set, see denoise_kernels.
+RAY_TRACER_ALWAYS_INLINE inline void estimate_variance_row(DenoisePlanes& planes, const int64_t y) {
+    const int64_t width = planes.width, height = planes.height;
+    const int64_t row = y * width;
+    for(int64_t block = 0;block < width;block += denoise_block){
+        const int64_t block_end = std::min(block + denoise_block, width);
+        double depth_scale[denoise_block], sum[denoise_block]{}, squared_sum[denoise_block]{},
+            weight_sum[denoise_block]{};
+        for(int64_t x = block;x < block_end;x++){
+            depth_scale[x - block] = 1 / (denoise_depth_sigma * std::max(planes.depth[row + x], 1e-6));
+        }
+        for(int64_t tap_y = std::max<int64_t>(y - 1, 0);tap_y <= std::min(y + 1, height - 1);tap_y++){
+            for(int64_t offset = -1;offset <= 1;offset++){
+                const int64_t tap_row = tap_y * width + offset;
+                const int64_t x_end = std::min(block_end, width - offset);
+                for(int64_t x = std::max(block, -offset);x < x_end;x++){
+                    const size_t pixel = row + x, tap = tap_row + x, k = x - block;
+                    const double weight = exp_nonpositive(-feature_distance(planes, pixel, tap, depth_scale[k]));
+                    const double value = planes.luminance[tap];
+                    sum[k] += weight * value;
+                    squared_sum[k] += weight * value * value;
+                    weight_sum[k] += weight;
+                }
+            }
+        }
+        for(int64_t x = block;x < block_end;x++){
+            const size_t k = x - block;
+            const double mean = sum[k] / weight_sum[k];
+            planes.variance[row + x] = std::max(squared_sum[k] / weight_sum[k] - mean * mean, 0.0);
+        }
+    }
+}
+
+/// @brief Filters the pixels of row y with one à-trous pass, 5x5 taps spaced `step` apart,
+/// into the filtered planes, a block of the row at a time like estimate_variance_row.
+RAY_TRACER_ALWAYS_INLINE inline void filter_row(DenoisePlanes& planes, const int64_t y, const int64_t step,
+    const double strength) {
+    static constexpr double kernel[5] = {1.0 / 16, 1.0 / 4, 3.0 / 8, 1.0 / 4, 1.0 / 16};
+    const int64_t width = planes.width, height = planes.height;
+    const int64_t row = y * width;
+    for(int64_t block = 0;block < width;block += denoise_block){
+        const int64_t block_end = std::min(block + denoise_block, width);
+        double luminance_scale[denoise_block], depth_scale[denoise_block], sum_x[denoise_block]{},
+            sum_y[denoise_block]{}, sum_z[denoise_block]{}, weight_sum[denoise_block]{},
+            variance_sum[denoise_block]{};
+        for(int64_t x = block;x < block_end;x++){
+            luminance_scale[x - block] = 1 / (strength * std::sqrt(planes.variance[row + x]) + 1e-4);
+            depth_scale[x - block] = 1 / (denoise_depth_sigma * static_cast<double>(step) * std::max(planes.depth[row + x], 1e-6));
+        }
+        for(int64_t j = 0;j < 5;j++){
+            const int64_t tap_y = y + (j - 2) * step;
+            if(tap_y < 0 || tap_y >= height){
+                continue;
+            }
+            for(int64_t i = 0;i < 5;i++){
+                const int64_t offset = (i - 2) * step;
+                const int64_t tap_row = tap_y * width + offset;
+                const int64_t x_end = std::min(block_end, width - offset);
+                for(int64_t x = std::max(block, -offset);x < x_end;x++){
+                    const size_t pixel = row + x, tap = tap_row + x, k = x - block;
+                    const double weight = kernel[i] * kernel[j] * exp_nonpositive(
+                        -std::fabs(planes.luminance[tap] - planes.luminance[pixel]) * luminance_scale[k]
+                        - feature_distance(planes, pixel, tap, depth_scale[k]));
+                    sum_x[k] += weight * planes.lighting[0][tap];
+                    sum_y[k] += weight * planes.lighting[1][tap];
+                    sum_z[k] += weight * planes.lighting[2][tap];
+                    weight_sum[k] += weight;
+                    variance_sum[k] += weight * weight * planes.variance[tap];
+                }
+            }
+        }
+        for(int64_t x = block;x < block_end;x++){
+            const size_t k = x - block;
+            planes.filtered[0][row + x] = sum_x[k] / weight_sum[k];
+            planes.filtered[1][row + x] = sum_y[k] / weight_sum[k];
+            planes.filtered[2][row + x] = sum_z[k] / weight_sum[k];
+            planes.filtered_variance[row + x] = variance_sum[k] / (weight_sum[k] * weight_sum[k]);
+        }
+    }
+}
+
+/// @brief Row kernels of the denoiser, compiled for one instruction set.
+struct DenoiseKernels{
+    void (*estimate_variance_row)(DenoisePlanes& planes, int64_t y);
+    void (*filter_row)(DenoisePlanes& planes, int64_t y, int64_t step, double strength);
+};
+
+#ifdef RAY_TRACER_X86_SIMD
+__attribute__((target("avx2")))
+inline void estimate_variance_row_avx2(DenoisePlanes& planes, const int64_t y) {
+    estimate_variance_row(planes, y);
+}
+
+__attribute__((target("avx2")))
+inline void filter_row_avx2(DenoisePlanes& planes, const int64_t y, const int64_t step, const double strength) {
+    filter_row(planes, y, step, strength);
+}
+
+__attribute__((target("avx512f")))
+inline void estimate_variance_row_avx512(DenoisePlanes& planes, const int64_t y) {
+    estimate_variance_row(planes, y);
+}
+
+__attribute__((target("avx512f")))
+inline void filter_row_avx512(DenoisePlanes& planes, const int64_t y, const int64_t step, const double strength) {
+    filter_row(planes, y, step, strength);
+}
+#endif
+
+/// @brief Returns the row kernels for the widest instruction set the processor supports,
+/// selected once like the sphere packet kernels. All of them give the same bits, as the
+/// build never fuses multiply-adds.
+inline const DenoiseKernels& denoise_kernels() noexcept {
+    static const DenoiseKernels kernels = []() -> DenoiseKernels {
+        switch(detect_simd_level()){
+#ifdef RAY_TRACER_X86_SIMD
+            case SimdLevel::AVX512: return {estimate_variance_row_avx512, filter_row_avx512};
+            case SimdLevel::AVX2: return {estimate_variance_row_avx2, filter_row_avx2};
+#endif
+            default: return {estimate_variance_row, filter_row};
+        }
+    }();
+    return kernels;
+}
+
+/// @brief Removes the noise of a rendered image with an edge-avoiding à-trous wavelet filter
+/// (Dammertz et al. 2010), guided by the features of its pixels, with the luminance weights of
+/// spatiotemporal variance-guided filtering (Schied et al. 2017) without the temporal part.
+/// The image is divided by the albedo first, so only the lighting is smoothed and the edges of
+/// the surface colors stay sharp. The noise of every pixel is estimated from the variance of
+/// the lighting of its neighbours with similar features. Every iteration then averages every
+/// pixel with 5x5 pixels spaced 2^iteration apart, weighting each of them by the B3 spline
+/// kernel, by how much their features resemble the pixel's, and by how many standard
+/// deviations of the noise their lighting is away. The rows of every pass run in parallel,
+/// the pixels of a row in vector lanes.
+inline Framebuffer denoise(const Framebuffer& image, const FeatureBuffers& features,
+    const RenderSettings& settings) {
+    const DenoiseKernels& kernels = denoise_kernels();
+    DenoisePlanes planes(image, features);
+    const SharedThreadPool pool = shared_thread_pool(settings.thread_count);
+    pool->run(static_cast<size_t>(planes.height), [&](const size_t row, size_t){
+        kernels.estimate_variance_row(planes, static_cast<int64_t>(row));
+    });
+    for(uint8_t iteration = 0;iteration < settings.denoise_iterations;iteration++){
+        pool->run(static_cast<size_t>(planes.height), [&](const size_t row, size_t){
+            kernels.filter_row(planes, static_cast<int64_t>(row), int64_t(1) << iteration, settings.denoise_strength);
+        });
+        planes.swap_filtered();
+    }
+
+    Framebuffer result = image;
+    for(size_t i = 0;i < result.pixels.size();i++){
+        result.pixels[i] = Color(
+            planes.lighting[0][i] * std::max<double>(planes.albedo[0][i], DenoisePlanes::min_albedo),
+            planes.lighting[1][i] * std::max<double>(planes.albedo[1][i], DenoisePlanes::min_albedo),
+            planes.lighting[2][i] * std::max<double>(planes.albedo[2][i], DenoisePlanes::min_albedo));
+    }
+    return result;
+}
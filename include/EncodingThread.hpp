@@ -0,0 +1,123 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Framebuffer.hpp"
+#include "ImageEncoder.hpp"
+
+/// @brief Encodes finished framebuffers and writes them to their streams on a thread of its
+/// own, so the render threads can continue with the next frame in the meantime. Images that
+/// can't be written are reported by finish.
+class EncodingThread{
+private:
+    static constexpr size_t max_queued = 4; // Submitting more images waits for the encoder
+
+    struct Job{
+        Framebuffer image;
+        std::ostream* out; // Stream to write to, or nullptr to write to the file at `path`
+        std::string path;  // Names the stream in errors if `out` isn't nullptr
+    };
+
+    const std::unique_ptr<ImageEncoder> encoder;
+    std::mutex mutex;
+    std::condition_variable jobs_changed;
+    std::condition_variable job_taken;
+    std::deque<Job> jobs;
+    std::vector<std::string> failed; // Files and streams that couldn't be written
+    bool stopping = false;
+    std::thread worker;
+
+    inline void work() {
+        while(true){
+            std::unique_lock<std::mutex> lock(mutex);
+            jobs_changed.wait(lock, [&]{ return stopping || !jobs.empty(); });
+            if(jobs.empty()){
+                return;
+            }
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            job_taken.notify_one();
+
+            std::ofstream file;
+            if(job.out == nullptr){
+                file.open(job.path, std::ios::binary);
+                job.out = &file;
+            }
+            if(*job.out){
+                encoder->write(*job.out, job.image);
+                job.out->flush();
+            }
+            if(!*job.out){
+                const std::lock_guard<std::mutex> failed_lock(mutex);
+                failed.push_back(std::move(job.path));
+            }
+        }
+    }
+
+    inline void enqueue(Job&& job) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_taken.wait(lock, [&]{ return jobs.size() < max_queued; });
+            jobs.push_back(std::move(job));
+        }
+        jobs_changed.notify_one();
+    }
+
+    inline void stop() noexcept {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobs_changed.notify_one();
+        if(worker.joinable()){
+            worker.join();
+        }
+    }
+public:
+    inline explicit EncodingThread(const ImageFormat format)
+        : encoder(make_encoder(format)), worker(&EncodingThread::work, this) {}
+
+    EncodingThread(const EncodingThread&) = delete;
+    EncodingThread& operator=(const EncodingThread&) = delete;
+
+    /// @brief Writes any images still queued, then stops the thread.
+    inline ~EncodingThread() noexcept {
+        stop();
+    }
+
+    /// @brief Writes any images still queued, then stops the thread. Returns whether every
+    /// image could be written, error names the files and streams that couldn't. No image
+    /// can be submitted afterwards.
+    inline bool finish(std::string& error) {
+        stop();
+        if(failed.empty()){
+            return true;
+        }
+        error = "can't write ";
+        for(size_t i = 0;i < failed.size();i++){
+            error += (i == 0? "" : ", ") + failed[i];
+        }
+        return false;
+    }
+
+    /// @brief Queues an image to be encoded and written to the stream, which must outlive
+    /// the EncodingThread, `name` names it in errors. Waits while max_queued images are
+    /// waiting already.
+    inline void submit(Framebuffer&& image, std::ostream& out, std::string name) {
+        enqueue(Job{std::move(image), &out, std::move(name)});
+    }
+
+    /// @brief Queues an image to be encoded and written to a new file at the path.
+    inline void submit(Framebuffer&& image, std::string path) {
+        enqueue(Job{std::move(image), nullptr, std::move(path)});
+    }
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Color.hpp"
+
+/// @brief In-memory image the render threads write their finished pixels into. Besides the
+/// pixels, it keeps the exact sums they are the mean of, so partial renders of the same frame
+/// can be merged. A framebuffer can also hold a band of consecutive full rows of a larger
+/// image, pixels are then still addressed by their position in the whole image.
+struct Framebuffer{
+    uint32_t width, height;
+    uint32_t first_row;                  // Row of the whole image the first row holds, 0 for whole images
+    std::vector<Color> pixels;           // Row-major, starting at the upper left pixel
+    std::vector<uint16_t> sample_counts; // Samples taken for every pixel, in the same order
+    std::vector<ColorSum> sums;          // Sum of the samples of every pixel, in the same order
+
+    inline Framebuffer(const uint32_t image_width, const uint32_t image_height, const uint32_t first_image_row = 0)
+        : width(image_width), height(image_height), first_row(first_image_row),
+        pixels(static_cast<size_t>(image_width) * image_height),
+        sample_counts(pixels.size()), sums(pixels.size()) {}
+
+    /// @brief Returns the index of the pixel at x, y of the whole image in the pixel vectors.
+    inline size_t index(const uint32_t x, const uint32_t y) const noexcept {
+        return static_cast<size_t>(y - first_row) * width + x;
+    }
+
+    inline Color& at(const uint32_t x, const uint32_t y) noexcept {
+        return pixels[index(x, y)];
+    }
+
+    inline const Color& at(const uint32_t x, const uint32_t y) const noexcept {
+        return pixels[index(x, y)];
+    }
+
+    /// @brief Stores the samples taken for a pixel and sets it to their mean.
+    inline void set_samples(const uint32_t x, const uint32_t y, const ColorSum& sum,
+        const uint16_t count) noexcept {
+        const size_t pixel = index(x, y);
+        sums[pixel] = sum;
+        sample_counts[pixel] = count;
+        pixels[pixel] = sum.mean(count);
+    }
+
+    /// @brief Adds the samples of another render of the same frame, which must have the same size.
+    /// Returns false without changing the image if a pixel would get more than 65535 samples.
+    inline bool merge(const Framebuffer& other) noexcept {
+        for(size_t i = 0;i < pixels.size();i++){
+            if(sample_counts[i] + other.sample_counts[i] > UINT16_MAX){
+                return false;
+            }
+        }
+        for(size_t i = 0;i < pixels.size();i++){
+            sums[i].add(other.sums[i]);
+            sample_counts[i] += other.sample_counts[i];
+            pixels[i] = sums[i].mean(sample_counts[i]);
+        }
+        return true;
+    }
+
+    /// @brief Returns a grayscale image of the sample counts, white for the largest count.
+    /// The values are squared to cancel out the gamma correction of the encoders.
+    inline Framebuffer sample_count_map() const {
+        Framebuffer map(width, height);
+        if(sample_counts.empty()){
+            return map;
+        }
+        const uint16_t max_count = std::max<uint16_t>(1,
+            *std::max_element(sample_counts.begin(), sample_counts.end()));
+        for(size_t i = 0;i < pixels.size();i++){
+            const double value = static_cast<double>(sample_counts[i]) / max_count;
+            map.pixels[i] = Color(value * value, value * value, value * value);
+            map.sample_counts[i] = sample_counts[i];
+        }
+        return map;
+    }
+};
@@ -2,15 +2,18 @@
 
 #include "Ray.hpp"
 #include "Interval.hpp"
+#include "AABB.hpp"
 
-class Material;
+#include <cstdint>
+#include <type_traits>
 
+/// @brief Where a ray hit an object. Only holds plain values, so copying it is cheap.
 struct HitRecord{
     Point3 point;
     Vec3 normal;
     double time;
     bool front_face;
-    std::shared_ptr<Material> material;
+    uint32_t material; // Index of the material in the scene's MaterialTable
 
     inline void set_face_normal(const Ray& ray, const Vec3& outward_normal) noexcept {
         // Sets the hit record normal vector.
@@ -20,8 +23,13 @@ struct HitRecord{
     }
 };
 
+static_assert(std::is_trivially_copyable_v<HitRecord>, "HitRecord must stay cheap to copy");
+
 class Hittable{
 public:
     virtual ~Hittable() noexcept = default;
     inline virtual bool hit(const Ray& ray, const Interval ray_time, HitRecord& record) const = 0;
+
+    /// @brief Returns a box enclosing the whole object, used to build acceleration structures.
+    inline virtual AABB bounding_box() const = 0;
 };
@@ -1,42 +1,69 @@
 #pragma once
 
-#include <memory>
+#include <cstdint>
 #include <vector>
 #include <initializer_list>
 
 #include "Hittable.hpp"
+#include "Sphere.hpp"
 
-struct HittableList : public Hittable {
-    std::vector<std::shared_ptr<Hittable>> objects;
+/// @brief Non-owning view of a range of spheres in a SphereStorage plus any other objects.
+/// The spheres are tested with the packet kernels, the other objects one by one.
+struct HittableList final : public Hittable {
+    const SphereStorage* spheres = nullptr; // Storage the sphere range refers to
+    uint32_t sphere_begin = 0, sphere_end = 0;
+    std::vector<const Hittable*> objects;   // Further objects, owned elsewhere
 
     inline HittableList() {}
-    
-    inline HittableList(std::shared_ptr<Hittable> object) : objects{object} {}
 
-    inline HittableList(std::initializer_list<std::shared_ptr<Hittable>> object_list)
+    inline explicit HittableList(const SphereStorage& storage)
+        : spheres(&storage), sphere_begin(0), sphere_end(static_cast<uint32_t>(storage.size())) {}
+
+    inline HittableList(std::initializer_list<const Hittable*> object_list)
         : objects(object_list) {}
 
     inline void clear() {
+        spheres = nullptr;
+        sphere_begin = sphere_end = 0;
         objects.clear();
     }
 
-    inline void add(std::shared_ptr<Hittable> object){
-        objects.push_back(object);
+    inline void add(const Hittable& object){
+        objects.push_back(&object);
     }
 
+    /// @brief Finds the nearest hit. The nearest sphere is only resolved into the record if
+    /// none of the other objects is closer.
     inline bool hit(const Ray& ray, const Interval ray_time, HitRecord& record) const override {
-        bool hit_anything = false;
-        double closest_so_far = ray_time.max;
+        const SphereHit nearest_sphere = spheres != nullptr?
+            nearest_sphere_hit(spheres->geometry, ray, ray_time, sphere_begin, sphere_end) : SphereHit();
+        double closest_so_far = nearest_sphere.index != SphereHit::no_hit? nearest_sphere.time : ray_time.max;
+        bool object_nearest = false;
 
-        for(const std::shared_ptr<Hittable>& object : objects){
+        for(const Hittable* object : objects){
             HitRecord temp_record;
             if(object->hit(ray, Interval(ray_time.min, closest_so_far), temp_record)){
-                hit_anything = true;
+                object_nearest = true;
                 closest_so_far = temp_record.time;
                 record = temp_record;
             }
         }
 
-        return hit_anything;
+        if(!object_nearest && nearest_sphere.index != SphereHit::no_hit){
+            spheres->fill_record(ray, nearest_sphere.index, nearest_sphere.time, record);
+            return true;
+        }
+        return object_nearest;
+    }
+
+    inline AABB bounding_box() const override {
+        AABB bounds;
+        for(uint32_t i = sphere_begin;i < sphere_end;i++){
+            bounds = bounds.merge(spheres->bounding_box(i));
+        }
+        for(const Hittable* object : objects){
+            bounds = bounds.merge(object->bounding_box());
+        }
+        return bounds;
     }
 };
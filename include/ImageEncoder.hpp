@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "Color.hpp"
+#include "Framebuffer.hpp"
+
+/// File formats a rendered image can be written in.
+enum class ImageFormat : uint8_t {
+    P3,  // ASCII PPM
+    P6,  // Binary PPM
+    PNG, // Lossless PNG with stored (uncompressed) deflate blocks
+    PFM  // Linear 32-bit float Portable FloatMap, without gamma or clamping
+};
+
+/// @brief Writes framebuffers as image files. An image is written whole, or band by band
+/// for images too large to keep in memory: begin with the size of the whole image, then
+/// write_band for bands of consecutive full rows, in the order of bottom_up, then finish.
+/// An encoder writes one image at a time.
+class ImageEncoder{
+public:
+    virtual ~ImageEncoder() = default;
+
+    /// @brief Returns whether the format stores the rows bottom to top, the bands then have to
+    /// be written from the bottom of the image up.
+    virtual bool bottom_up() const noexcept {
+        return false;
+    }
+
+    virtual void begin(std::ostream& out, uint32_t width, uint32_t height) = 0;
+    virtual void write_band(std::ostream& out, const Framebuffer& band) = 0;
+    virtual void finish(std::ostream&) {}
+
+    inline void write(std::ostream& out, const Framebuffer& image) {
+        begin(out, image.width, image.height);
+        write_band(out, image);
+        finish(out);
+    }
+
+    /// @brief Returns the bytes of the image file.
+    inline std::string encode(const Framebuffer& image) {
+        std::ostringstream out;
+        write(out, image);
+        return out.str();
+    }
+};
+
+class PPMEncoder : public ImageEncoder {
+private:
+    const bool binary;
+    std::string bytes; // Binary pixels of the current band
+public:
+    inline explicit PPMEncoder(const bool binary_format) noexcept : binary(binary_format) {}
+
+    inline void begin(std::ostream& out, const uint32_t width, const uint32_t height) override {
+        out << (binary? "P6" : "P3") << '\n' << width << ' ' << height << "\n255\n";
+    }
+
+    inline void write_band(std::ostream& out, const Framebuffer& band) override {
+        if(!binary){
+            for(const Color& pixel_color : band.pixels){
+                write_color(out, pixel_color);
+            }
+            return;
+        }
+
+        bytes.resize(3 * band.pixels.size());
+        for(size_t i = 0;i < band.pixels.size();i++){
+            bytes[3 * i] = static_cast<char>(component_to_byte(band.pixels[i].x()));
+            bytes[3 * i + 1] = static_cast<char>(component_to_byte(band.pixels[i].y()));
+            bytes[3 * i + 2] = static_cast<char>(component_to_byte(band.pixels[i].z()));
+        }
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+};
+
+/// @brief PNG of stored (uncompressed) deflate blocks. Every band becomes IDAT chunks of its
+/// own, the chunks together holding one zlib stream.
+class PNGEncoder : public ImageEncoder {
+private:
+    static constexpr uint16_t max_block_size = 65535; // Largest stored deflate block
+    static constexpr size_t max_chunk_size = 1 << 20; // Of IDAT chunks, PNG allows less than 2^31 bytes
+
+    uint64_t raw_size = 0;    // Filter bytes and pixels of the whole image
+    uint64_t raw_written = 0; // Of them written so far
+    uint32_t adler_a = 1, adler_b = 0; // Adler-32 of the written bytes
+    std::string raw, chunk;
+
+    static inline uint32_t crc32(const std::string_view data, uint32_t crc = 0) noexcept {
+        static const std::array<uint32_t, 256> table = []{
+            std::array<uint32_t, 256> entries{};
+            for(uint32_t i = 0;i < 256;i++){
+                uint32_t value = i;
+                for(uint8_t bit = 0;bit < 8;bit++){
+                    value = value & 1? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                }
+                entries[i] = value;
+            }
+            return entries;
+        }();
+        crc = ~crc;
+        for(const char byte : data){
+            crc = table[(crc ^ static_cast<uint8_t>(byte)) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    static inline void append_u32(std::string& out, const uint32_t value) {
+        out.push_back(static_cast<char>(value >> 24));
+        out.push_back(static_cast<char>(value >> 16));
+        out.push_back(static_cast<char>(value >> 8));
+        out.push_back(static_cast<char>(value));
+    }
+
+    static inline void write_chunk(std::ostream& out, const char* const type, const std::string_view data) {
+        std::string frame;
+        append_u32(frame, static_cast<uint32_t>(data.size()));
+        frame.append(type, 4);
+        out.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        frame.clear();
+        append_u32(frame, crc32(data, crc32(std::string_view(type, 4))));
+        out.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+    }
+public:
+    inline void begin(std::ostream& out, const uint32_t width, const uint32_t height) override {
+        raw_size = (1 + 3 * static_cast<uint64_t>(width)) * height;
+        raw_written = 0;
+        adler_a = 1;
+        adler_b = 0;
+
+        std::string header;
+        append_u32(header, width);
+        append_u32(header, height);
+        header.append("\x08\x02\x00\x00\x00", 5); // 8 bits per channel, RGB, no interlacing
+        out.write("\x89PNG\r\n\x1a\n", 8);
+        write_chunk(out, "IHDR", header);
+    }
+
+    inline void write_band(std::ostream& out, const Framebuffer& band) override {
+        // Rows of filter type 0 followed by RGB bytes
+        const size_t row_size = 1 + 3 * static_cast<size_t>(band.width);
+        raw.assign(row_size * band.height, '\0');
+        for(size_t row = 0;row < band.height;row++){
+            for(size_t x = 0;x < band.width;x++){
+                const Color& pixel_color = band.pixels[row * band.width + x];
+                char* const pixel = &raw[row * row_size + 1 + 3 * x];
+                pixel[0] = static_cast<char>(component_to_byte(pixel_color.x()));
+                pixel[1] = static_cast<char>(component_to_byte(pixel_color.y()));
+                pixel[2] = static_cast<char>(component_to_byte(pixel_color.z()));
+            }
+        }
+
+        // The zlib header starts the first band, the last block of the image ends the stream
+        chunk.clear();
+        if(raw_written == 0){
+            chunk.append("\x78\x01", 2);
+        }
+        for(size_t offset = 0;offset < raw.size();offset += max_block_size){
+            const uint16_t size = static_cast<uint16_t>(std::min<size_t>(max_block_size, raw.size() - offset));
+            chunk.push_back(raw_written + offset + size == raw_size? 1 : 0);
+            chunk.push_back(static_cast<char>(size & 0xFF));
+            chunk.push_back(static_cast<char>(size >> 8));
+            chunk.push_back(static_cast<char>(~size & 0xFF));
+            chunk.push_back(static_cast<char>((~size >> 8) & 0xFF));
+            chunk.append(raw, offset, size);
+        }
+        for(const char byte : raw){
+            adler_a = (adler_a + static_cast<uint8_t>(byte)) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+        raw_written += raw.size();
+        for(size_t offset = 0;offset < chunk.size();offset += max_chunk_size){
+            write_chunk(out, "IDAT", std::string_view(chunk).substr(offset, max_chunk_size));
+        }
+    }
+
+    inline void finish(std::ostream& out) override {
+        // An empty image still needs a zlib stream of one empty block
+        if(raw_size == 0){
+            write_chunk(out, "IDAT", std::string_view("\x78\x01\x01\x00\x00\xff\xff", 7));
+        }
+        std::string checksum;
+        append_u32(checksum, (adler_b << 16) | adler_a);
+        write_chunk(out, "IDAT", checksum);
+        write_chunk(out, "IEND", "");
+    }
+};
+
+class PFMEncoder : public ImageEncoder {
+private:
+    std::string bytes; // Pixels of the current band
+public:
+    // Rows are stored bottom to top
+    inline bool bottom_up() const noexcept override {
+        return true;
+    }
+
+    // A negative scale marks little-endian data
+    inline void begin(std::ostream& out, const uint32_t width, const uint32_t height) override {
+        out << "PF\n" << width << ' ' << height << "\n-1.0\n";
+    }
+
+    inline void write_band(std::ostream& out, const Framebuffer& band) override {
+        bytes.resize(3 * sizeof(float) * band.pixels.size());
+        char* pixel = bytes.data();
+        for(size_t row = band.height;row-- > 0;){
+            for(size_t x = 0;x < band.width;x++){
+                const Color& pixel_color = band.pixels[row * band.width + x];
+                const float components[3] = {
+                    static_cast<float>(pixel_color.x()), static_cast<float>(pixel_color.y()),
+                    static_cast<float>(pixel_color.z())
+                };
+                std::memcpy(pixel, components, sizeof(components));
+                pixel += sizeof(components);
+            }
+        }
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+};
+
+inline std::unique_ptr<ImageEncoder> make_encoder(const ImageFormat format) {
+    switch(format){
+        case ImageFormat::P3: return std::make_unique<PPMEncoder>(false);
+        case ImageFormat::PNG: return std::make_unique<PNGEncoder>();
+        case ImageFormat::PFM: return std::make_unique<PFMEncoder>();
+        default: return std::make_unique<PPMEncoder>(true);
+    }
+}
+
+/// @brief Returns the usual file name extension of the format, without the dot.
+inline const char* image_extension(const ImageFormat format) noexcept {
+    switch(format){
+        case ImageFormat::PNG: return "png";
+        case ImageFormat::PFM: return "pfm";
+        default: return "ppm";
+    }
+}
+
+/// @brief Parses a format name (p3, p6, png or pfm), returns false for unknown names.
+inline bool parse_image_format(const std::string_view name, ImageFormat& format) noexcept {
+    if(name == "p3"){
+        format = ImageFormat::P3;
+    }else if(name == "p6"){
+        format = ImageFormat::P6;
+    }else if(name == "png"){
+        format = ImageFormat::PNG;
+    }else if(name == "pfm"){
+        format = ImageFormat::PFM;
+    }else{
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Color.hpp"
+#include "Framebuffer.hpp"
+
+/// @brief How far an image is from a reference image of the same size.
+struct ImageError{
+    double rmse;   // Root of the mean squared difference of the linear color components
+    double relmse; // Mean of the squared differences relative to the squared reference, see relative_mse
+    double ssim;   // Mean structural similarity of the displayed luminance, 1 for equal images
+};
+
+/// @brief Returns the root of the mean squared difference over all color components.
+inline double rmse(const Framebuffer& image, const Framebuffer& reference) noexcept {
+    double sum = 0;
+    for(size_t i = 0;i < image.pixels.size();i++){
+        sum += (image.pixels[i] - reference.pixels[i]).length_squared();
+    }
+    return std::sqrt(sum / (3.0 * std::max<size_t>(image.pixels.size(), 1)));
+}
+
+/// @brief Returns the mean of (value - reference)^2 / (reference^2 + 0.01) over all color
+/// components, which weighs errors in dark regions as much as in bright ones, the offset
+/// keeping black pixels of the reference from dominating it.
+inline double relative_mse(const Framebuffer& image, const Framebuffer& reference) noexcept {
+    static constexpr double offset = 0.01;
+    double sum = 0;
+    for(size_t i = 0;i < image.pixels.size();i++){
+        for(int axis = 0;axis < 3;axis++){
+            const double difference = image.pixels[i][axis] - reference.pixels[i][axis];
+            sum += difference * difference / (reference.pixels[i][axis] * reference.pixels[i][axis] + offset);
+        }
+    }
+    return sum / (3.0 * std::max<size_t>(image.pixels.size(), 1));
+}
+
+/// @brief Luminance of a pixel the way the image encoders display it: gamma corrected and
+/// clamped to [0, 1].
+inline double display_luminance(const Color& color) noexcept {
+    const auto display = [](const double component){
+        return std::clamp(linear_to_gamma(component), 0.0, 1.0);
+    };
+    return 0.2126 * display(color.x()) + 0.7152 * display(color.y()) + 0.0722 * display(color.z());
+}
+
+/// @brief Returns the mean structural similarity (Wang et al. 2004) of the displayed
+/// luminance of the images, with the usual 11x11 Gaussian window of standard deviation 1.5.
+/// Windows reaching over the border are cut off and renormalized.
+inline double ssim(const Framebuffer& image, const Framebuffer& reference) {
+    static constexpr int radius = 5;
+    static constexpr double sigma = 1.5;
+    static constexpr double c1 = 0.01 * 0.01, c2 = 0.03 * 0.03; // For values in [0, 1]
+    static const std::array<double, 2 * radius + 1> kernel = []{
+        std::array<double, 2 * radius + 1> weights{};
+        for(int i = -radius;i <= radius;i++){
+            weights[i + radius] = std::exp(-i * i / (2 * sigma * sigma));
+        }
+        return weights;
+    }();
+    const int64_t width = image.width, height = image.height;
+    if(width == 0 || height == 0){
+        return 1;
+    }
+
+    // Local means of x, y, x^2, y^2 and xy, filtered along the rows, then along the columns
+    static constexpr size_t moments = 5;
+    std::vector<double> values(moments * image.pixels.size()), rows(values.size()), means(values.size());
+    for(size_t i = 0;i < image.pixels.size();i++){
+        const double x = display_luminance(image.pixels[i]), y = display_luminance(reference.pixels[i]);
+        const double pixel_values[moments] = {x, y, x * x, y * y, x * y};
+        std::copy_n(pixel_values, moments, &values[moments * i]);
+    }
+    const auto filter = [&](const std::vector<double>& in, std::vector<double>& out, const int64_t step,
+        const int64_t length){
+        for(int64_t y = 0;y < height;y++){
+            for(int64_t x = 0;x < width;x++){
+                const int64_t position = step == 1? x : y;
+                const size_t pixel = static_cast<size_t>(y * width + x);
+                double sums[moments] = {}, weight_sum = 0;
+                for(int64_t tap = std::max<int64_t>(-radius, -position);
+                    tap <= std::min<int64_t>(radius, length - 1 - position);tap++){
+                    const double weight = kernel[tap + radius];
+                    const size_t other = static_cast<size_t>(static_cast<int64_t>(pixel) + tap * step);
+                    for(size_t moment = 0;moment < moments;moment++){
+                        sums[moment] += weight * in[moments * other + moment];
+                    }
+                    weight_sum += weight;
+                }
+                for(size_t moment = 0;moment < moments;moment++){
+                    out[moments * pixel + moment] = sums[moment] / weight_sum;
+                }
+            }
+        }
+    };
+    filter(values, rows, 1, width);
+    filter(rows, means, width, height);
+
+    double sum = 0;
+    for(size_t i = 0;i < image.pixels.size();i++){
+        const double* const mean = &means[moments * i];
+        const double variance_x = mean[2] - mean[0] * mean[0], variance_y = mean[3] - mean[1] * mean[1];
+        const double covariance = mean[4] - mean[0] * mean[1];
+        sum += (2 * mean[0] * mean[1] + c1) * (2 * covariance + c2)
+            / ((mean[0] * mean[0] + mean[1] * mean[1] + c1) * (variance_x + variance_y + c2));
+    }
+    return sum / image.pixels.size();
+}
+
+/// @brief Returns all error metrics of an image against a reference of the same size.
+inline ImageError image_error(const Framebuffer& image, const Framebuffer& reference) {
+    return ImageError{rmse(image, reference), relative_mse(image, reference), ssim(image, reference)};
+}
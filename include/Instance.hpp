@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Hittable.hpp"
+#include "Transform.hpp"
+
+/// @brief Places shared geometry in the scene through an affine transform. Rays are moved into
+/// the object space of the geometry and hits back into world space, so any number of instances
+/// can refer to one HittableList or BVH, and an instance costs the same no matter how many
+/// primitives it shows.
+class Instance final : public Hittable {
+private:
+    const Hittable& object;
+    Transform to_world;  // Object space to world space
+    Transform to_object; // World space to object space
+    AABB bounds;         // World space bounds
+public:
+    inline Instance(const Hittable& shared_object, const Transform& transform) noexcept
+        : object(shared_object), to_world(transform), to_object(transform.inverse()),
+        bounds(transform.box(shared_object.bounding_box())) {}
+
+    inline bool hit(const Ray& ray, const Interval ray_time, HitRecord& record) const override {
+        // The direction is not normalized, so the ray times are the same in both spaces
+        const Ray object_ray(to_object.point(ray.origin()), to_object.vector(ray.direction()));
+        if(!object.hit(object_ray, ray_time, record)){
+            return false;
+        }
+        // The transform preserves the sign of the normal's dot product with the ray, so
+        // front_face stays valid
+        record.point = to_world.point(record.point);
+        record.normal = to_object.transposed_vector(record.normal).unit_vector();
+        return true;
+    }
+
+    inline AABB bounding_box() const override {
+        return bounds;
+    }
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RAY_TRACER_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// @brief Read-only view of a whole file. The file is memory-mapped where the platform
+/// supports it, so only the pages that are used get read, and read into memory otherwise.
+class MappedFile{
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+#ifndef RAY_TRACER_MMAP
+    std::vector<uint8_t> buffer;
+#endif
+public:
+    inline MappedFile() noexcept {}
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline ~MappedFile() noexcept {
+#ifdef RAY_TRACER_MMAP
+        if(bytes != nullptr){
+            munmap(const_cast<uint8_t*>(bytes), length);
+        }
+#endif
+    }
+
+    /// @brief Maps the file, returns false if it can't be opened.
+    inline bool open(const std::string& path) {
+#ifdef RAY_TRACER_MMAP
+        const int file = ::open(path.c_str(), O_RDONLY);
+        if(file < 0){
+            return false;
+        }
+        struct stat status;
+        if(fstat(file, &status) != 0){
+            close(file);
+            return false;
+        }
+        length = static_cast<size_t>(status.st_size);
+        if(length > 0){
+            void* const mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+            bytes = mapping == MAP_FAILED? nullptr : static_cast<const uint8_t*>(mapping);
+        }
+        close(file);
+        if(length > 0 && bytes == nullptr){
+            length = 0;
+            return false;
+        }
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary);
+        if(!file){
+            return false;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        bytes = buffer.data();
+        length = buffer.size();
+        return true;
+#endif
+    }
+
+    inline const uint8_t* data() const noexcept {
+        return bytes;
+    }
+
+    inline size_t size() const noexcept {
+        return length;
+    }
+};
@@ -2,24 +2,52 @@
 
 #include "Color.hpp"
 #include "Hittable.hpp"
+#include "Sampler.hpp"
+
+#include <cstdint>
+#include <variant>
+
+/// Material types a MaterialRecord can describe.
+enum class MaterialKind : uint32_t { Lambertian, Metal, Dielectric };
+
+/// @brief Flat description of a material, as stored in scene files.
+struct MaterialRecord{
+    MaterialKind kind = MaterialKind::Lambertian;
+    uint32_t reserved = 0;
+    double parameters[4]{}; // Lambertian: albedo, Metal: albedo and fuzz, Dielectric: refraction index
+};
 
 class Material{
 public:
     virtual ~Material() = default;
 
     virtual bool scatter(
-        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered) const = 0;
+        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered,
+        Sampler& sampler) const = 0;
+
+    /// @brief Returns the description to save the material with.
+    virtual MaterialRecord record() const = 0;
+
+    /// @brief Returns the color of the surface, which guides the denoiser.
+    virtual Color base_color() const = 0;
+
+    /// @brief Returns whether the material reflects or refracts the scene sharply enough for
+    /// the denoiser to be guided by what it shows rather than by its own surface.
+    virtual bool specular() const {
+        return false;
+    }
 };
 
-class Lambertian : public Material {
+class Lambertian final : public Material {
 private:
     const Color albedo;
 public:
     inline Lambertian(const Color albedo_value) noexcept : albedo(albedo_value) {}
 
     inline bool scatter(
-        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered) const{
-        Vec3 scatter_direction = record.normal + Vec3::random_unit_vector();
+        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered,
+        Sampler& sampler) const override {
+        Vec3 scatter_direction = record.normal + sampler.unit_vector();
         if(scatter_direction.near_zero()){
             scatter_direction = record.normal;
         }
@@ -27,10 +55,18 @@ public:
         attenuation = albedo;
         return true;
     }
+
+    inline MaterialRecord record() const override {
+        return MaterialRecord{MaterialKind::Lambertian, 0, {albedo.x(), albedo.y(), albedo.z()}};
+    }
+
+    inline Color base_color() const override {
+        return albedo;
+    }
 };
 
 
-class Metal : public Material {
+class Metal final : public Material {
 private:
     const Color albedo;
     const double fuzz;
@@ -38,17 +74,30 @@ public:
     inline Metal(const Color albedo_value, const double fuzz) noexcept : albedo(albedo_value), fuzz(std::min(fuzz, 1.0)) {}
 
     inline bool scatter(
-        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered) const override
+        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered,
+        Sampler& sampler) const override
         {
         const Vec3 reflected = ray_in.direction().reflect(record.normal).unit_vector() +
-            fuzz * Vec3::random_unit_vector();
+            fuzz * sampler.unit_vector();
         scattered = Ray(record.point, reflected);
         attenuation = albedo;
         return scattered.direction().dot(record.normal) > 0;
     }
+
+    inline MaterialRecord record() const override {
+        return MaterialRecord{MaterialKind::Metal, 0, {albedo.x(), albedo.y(), albedo.z(), fuzz}};
+    }
+
+    inline Color base_color() const override {
+        return albedo;
+    }
+
+    inline bool specular() const override {
+        return true;
+    }
 };
 
-class Dielectric : public Material {
+class Dielectric final : public Material {
 private:
     // Refractive index in vacuum or air, or the ratio of the material's refractive index over
     // the refractive index of the enclosing media.
@@ -65,7 +114,8 @@ private:
     inline constexpr Dielectric(const double refraction) noexcept : refraction_index(refraction) {}
 
     inline bool scatter(
-        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered) const override
+        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered,
+        Sampler& sampler) const override
         {
         attenuation = Color(1.0, 1.0, 1.0);
         const double ri = record.front_face ? (1 / refraction_index) : refraction_index;
@@ -75,10 +125,61 @@ private:
         const double sin_theta = std::sqrt(1 - cos_theta * cos_theta);
         
         const bool cannot_refract = ri * sin_theta > 1.0;
-        const Vec3 direction = cannot_refract || reflectance(cos_theta, ri) > random_double()?
+        const Vec3 direction = cannot_refract || reflectance(cos_theta, ri) > sampler.next_1d()?
             unit_direction.reflect(record.normal) : unit_direction.refract(record.normal, ri);
 
         scattered = Ray(record.point, direction);
         return true;
     }
+
+    inline MaterialRecord record() const override {
+        return MaterialRecord{MaterialKind::Dielectric, 0, {refraction_index}};
+    }
+
+    // Clear glass lets all light through
+    inline Color base_color() const override {
+        return Color(1, 1, 1);
+    }
+
+    inline bool specular() const override {
+        return true;
+    }
+};
+
+/// @brief Material of one of the built-in types, held by value. Calls are dispatched over the
+/// closed set of types with std::visit rather than through the vtable, so the compiler sees
+/// which scatter function runs and can inline it into the render loop.
+class BuiltinMaterial{
+public:
+    using Variant = std::variant<Lambertian, Metal, Dielectric>;
+private:
+    Variant material;
+public:
+    template<typename T>
+    inline BuiltinMaterial(const T& builtin) noexcept : material(builtin) {}
+
+    inline bool scatter(
+        const Ray& ray_in, const HitRecord& record, Color& attenuation, Ray& scattered,
+        Sampler& sampler) const {
+        return std::visit([&](const auto& builtin){
+            return builtin.scatter(ray_in, record, attenuation, scattered, sampler);
+        }, material);
+    }
+
+    inline MaterialRecord record() const {
+        return std::visit([](const auto& builtin){ return builtin.record(); }, material);
+    }
+
+    inline Color base_color() const {
+        return std::visit([](const auto& builtin){ return builtin.base_color(); }, material);
+    }
+
+    inline bool specular() const {
+        return std::visit([](const auto& builtin){ return builtin.specular(); }, material);
+    }
+
+    /// @brief Returns the index of the material's type in Variant.
+    inline uint8_t type() const noexcept {
+        return static_cast<uint8_t>(material.index());
+    }
 };
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <typeindex>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "Arena.hpp"
+#include "Material.hpp"
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#include <cstdlib>
+#endif
+
+/// @brief Owns the materials of a scene, which hit records refer to by 32-bit index.
+/// Materials of one type are constructed in an arena of that type, so adding a material doesn't
+/// allocate it on its own, materials of the same type end up next to each other in memory, and
+/// all of them are freed at once with the table.
+class MaterialTable{
+private:
+    static constexpr size_t pool_block_size = 4096;
+
+    std::vector<std::pair<std::type_index, MonotonicArena>> pools;
+    std::vector<const Material*> entries;
+    std::vector<uint8_t> entry_types; // Pool, and so material type, of every entry
+
+    template<typename T>
+    inline uint8_t pool_index() {
+        for(size_t i = 0;i < pools.size();i++){
+            if(pools[i].first == typeid(T)){
+                return static_cast<uint8_t>(i);
+            }
+        }
+        pools.emplace_back(typeid(T), MonotonicArena(pool_block_size));
+        return static_cast<uint8_t>(pools.size() - 1);
+    }
+public:
+    /// @brief Constructs a material of type T in the table and returns its index.
+    template<typename T, typename... Args>
+    inline uint32_t add(Args&&... args) {
+        const uint8_t type = pool_index<T>();
+        entries.push_back(&pools[type].second.create<T>(std::forward<Args>(args)...));
+        entry_types.push_back(type);
+        return static_cast<uint32_t>(entries.size() - 1);
+    }
+
+    /// @brief Constructs the material a record describes and returns its index.
+    inline uint32_t add(const MaterialRecord& record) {
+        const double* const p = record.parameters;
+        switch(record.kind){
+            case MaterialKind::Metal:
+                return add<Metal>(Color(p[0], p[1], p[2]), p[3]);
+            case MaterialKind::Dielectric:
+                return add<Dielectric>(p[0]);
+            default:
+                return add<Lambertian>(Color(p[0], p[1], p[2]));
+        }
+    }
+
+    inline const Material& operator[](const uint32_t index) const noexcept {
+        return *entries[index];
+    }
+
+    /// @brief Returns the material at the index if its type is T, else nullptr.
+    template<typename T>
+    inline const T* get_if(const uint32_t index) const noexcept {
+        return pools[entry_types[index]].first == typeid(T)? static_cast<const T*>(entries[index]) : nullptr;
+    }
+
+    inline size_t size() const noexcept {
+        return entries.size();
+    }
+
+    /// @brief Returns a number identifying the type of a material, in [0, type_count()).
+    inline uint8_t type_of(const uint32_t index) const noexcept {
+        return entry_types[index];
+    }
+
+    inline size_t type_count() const noexcept {
+        return pools.size();
+    }
+
+    /// @brief Returns the class name of every material type, indexed like type_of.
+    inline std::vector<std::string> type_names() const {
+        std::vector<std::string> names;
+        for(const std::pair<std::type_index, MonotonicArena>& entry : pools){
+            names.emplace_back(entry.first.name());
+#ifdef __GNUG__
+            int status;
+            char* const demangled = abi::__cxa_demangle(entry.first.name(), nullptr, nullptr, &status);
+            if(status == 0){
+                names.back() = demangled;
+            }
+            std::free(demangled);
+#endif
+        }
+        return names;
+    }
+};
+
+/// @brief Copy of a MaterialTable whose materials are all of the built-in types, stored by
+/// value in one array. Has the interface of MaterialTable the camera uses, so a render
+/// instantiated for it dispatches material calls over the closed set of types, see
+/// BuiltinMaterial. Material types are numbered by their index in BuiltinMaterial::Variant.
+class BuiltinMaterialTable{
+private:
+    std::vector<BuiltinMaterial> entries;
+public:
+    /// @brief Copies the materials of the table. Returns false, leaving this table empty, if
+    /// one of them isn't of a built-in type.
+    inline bool assign(const MaterialTable& table) {
+        entries.clear();
+        entries.reserve(table.size());
+        for(uint32_t i = 0;i < table.size();i++){
+            if(const Lambertian* const lambertian = table.get_if<Lambertian>(i)){
+                entries.emplace_back(*lambertian);
+            }else if(const Metal* const metal = table.get_if<Metal>(i)){
+                entries.emplace_back(*metal);
+            }else if(const Dielectric* const dielectric = table.get_if<Dielectric>(i)){
+                entries.emplace_back(*dielectric);
+            }else{
+                entries.clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline const BuiltinMaterial& operator[](const uint32_t index) const noexcept {
+        return entries[index];
+    }
+
+    inline size_t size() const noexcept {
+        return entries.size();
+    }
+
+    inline uint8_t type_of(const uint32_t index) const noexcept {
+        return entries[index].type();
+    }
+
+    inline size_t type_count() const noexcept {
+        return std::variant_size_v<BuiltinMaterial::Variant>;
+    }
+
+    inline std::vector<std::string> type_names() const {
+        return {"Lambertian", "Metal", "Dielectric"};
+    }
+};
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "TriangleMesh.hpp"
+
+// Meshes are read from Wavefront OBJ files and from PLY files in ASCII or binary form. The
+// file is memory-mapped and parsed in place, straight into the vertex and index arrays of a
+// MeshData: nothing is allocated per vertex or face, and a first pass counting the vertices
+// and faces lets the arrays be allocated once, so a mesh takes little more memory while
+// loading than when loaded. Polygons are split into fans of triangles.
+//
+// Only the positions and faces are used. OBJ files may use v, f with any of the v, v/vt,
+// v//vn and v/vt/vn forms and negative indices, other statements are ignored. PLY files need
+// x, y and z properties in the vertex element and a vertex_indices (or vertex_index) list in
+// the face element, other properties and elements are skipped.
+
+/// @brief Returns the end of the line starting at `line`, the position of its '\n' or `end`.
+inline const char* mesh_line_end(const char* const line, const char* const end) noexcept {
+    const void* const newline = std::memchr(line, '\n', static_cast<size_t>(end - line));
+    return newline != nullptr? static_cast<const char*>(newline) : end;
+}
+
+/// @brief Returns the start of the line after the one starting at `line`, or `end`.
+inline const char* mesh_next_line(const char* const line, const char* const end) noexcept {
+    const char* const line_end = mesh_line_end(line, end);
+    return line_end < end? line_end + 1 : end;
+}
+
+inline bool is_mesh_space(const char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline const char* skip_mesh_spaces(const char* position, const char* const end) noexcept {
+    while(position < end && is_mesh_space(*position)){
+        position++;
+    }
+    return position;
+}
+
+/// @brief Appends the triangles of a polygon with `count` vertices as a fan around its first vertex.
+inline void add_polygon(MeshData& mesh, const uint32_t* const polygon, const size_t count) {
+    for(size_t i = 2;i < count;i++){
+        mesh.indices.push_back(polygon[0]);
+        mesh.indices.push_back(polygon[i - 1]);
+        mesh.indices.push_back(polygon[i]);
+    }
+}
+
+/// @brief Checks that every face only refers to existing vertices.
+inline bool check_mesh_indices(const MeshData& mesh, std::string& error) {
+    const auto invalid = std::find_if(mesh.indices.begin(), mesh.indices.end(),
+        [&](const uint32_t index){ return index >= mesh.vertices.size(); });
+    if(invalid != mesh.indices.end()){
+        error = "triangle " + std::to_string((invalid - mesh.indices.begin()) / 3) + " refers to a missing vertex";
+        return false;
+    }
+    return true;
+}
+
+/// @brief Parses an OBJ file, error describes the first problem if it fails.
+inline bool parse_obj(const char* const begin, const char* const end, MeshData& mesh, std::string& error) {
+    size_t vertex_count = 0, face_count = 0;
+    for(const char* line = begin;line < end;line = mesh_next_line(line, end)){
+        if(end - line > 1 && (line[1] == ' ' || line[1] == '\t')){
+            vertex_count += line[0] == 'v';
+            face_count += line[0] == 'f';
+        }
+    }
+    mesh.vertices.reserve(vertex_count);
+    mesh.indices.reserve(3 * face_count); // Exact for triangle meshes, polygons grow it
+
+    std::vector<uint32_t> polygon;
+    size_t line_number = 1;
+    for(const char* line = begin;line < end;line = mesh_next_line(line, end), line_number++){
+        const char* const line_end = mesh_line_end(line, end);
+        const char* position = skip_mesh_spaces(line, line_end);
+        const char* const keyword_end = std::find_if(position, line_end, is_mesh_space);
+        const std::string_view keyword(position, static_cast<size_t>(keyword_end - position));
+        position = keyword_end;
+        if(keyword == "v"){
+            float coordinates[3];
+            for(float& coordinate : coordinates){
+                position = skip_mesh_spaces(position, line_end);
+                const std::from_chars_result result = std::from_chars(position, line_end, coordinate);
+                if(result.ec != std::errc()){
+                    error = "line " + std::to_string(line_number) + ": invalid v";
+                    return false;
+                }
+                position = result.ptr;
+            }
+            mesh.vertices.push_back(MeshVertex{coordinates[0], coordinates[1], coordinates[2]});
+        }else if(keyword == "f"){
+            polygon.clear();
+            while((position = skip_mesh_spaces(position, line_end)) < line_end){
+                int64_t index;
+                const std::from_chars_result result = std::from_chars(position, line_end, index);
+                // Negative indices count back from the last vertex so far
+                const int64_t vertex = index < 0? static_cast<int64_t>(mesh.vertices.size()) + index : index - 1;
+                if(result.ec != std::errc() || index == 0 || vertex < 0 || vertex >= UINT32_MAX){
+                    error = "line " + std::to_string(line_number) + ": invalid f";
+                    return false;
+                }
+                polygon.push_back(static_cast<uint32_t>(vertex));
+                // Skip the texture coordinate and normal indices
+                position = std::find_if(result.ptr, line_end, is_mesh_space);
+            }
+            if(polygon.size() < 3){
+                error = "line " + std::to_string(line_number) + ": a face needs three vertices";
+                return false;
+            }
+            add_polygon(mesh, polygon.data(), polygon.size());
+        }
+    }
+    return check_mesh_indices(mesh, error);
+}
+
+/// Value types of PLY properties.
+enum class PlyType : uint8_t { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+/// @brief Parses the name of a PLY type, returns PlyType::Invalid for unknown names.
+inline PlyType parse_ply_type(const std::string_view name) noexcept {
+    static constexpr std::pair<std::string_view, PlyType> names[] = {
+        {"char", PlyType::Int8}, {"int8", PlyType::Int8}, {"uchar", PlyType::UInt8}, {"uint8", PlyType::UInt8},
+        {"short", PlyType::Int16}, {"int16", PlyType::Int16}, {"ushort", PlyType::UInt16},
+        {"uint16", PlyType::UInt16}, {"int", PlyType::Int32}, {"int32", PlyType::Int32},
+        {"uint", PlyType::UInt32}, {"uint32", PlyType::UInt32}, {"float", PlyType::Float32},
+        {"float32", PlyType::Float32}, {"double", PlyType::Float64}, {"float64", PlyType::Float64}};
+    for(const auto& [type_name, type] : names){
+        if(name == type_name){
+            return type;
+        }
+    }
+    return PlyType::Invalid;
+}
+
+/// @brief Property of a PLY element, either one value or a list of values preceded by their count.
+struct PlyProperty{
+    std::string name;
+    PlyType type;       // Type of the value, or of the items of a list
+    PlyType count_type; // Type of the count of a list, Invalid for single values
+};
+
+struct PlyElement{
+    std::string name;
+    uint64_t count;
+    std::vector<PlyProperty> properties;
+};
+
+/// @brief Reads the values of the body of a PLY file one after the other.
+class PlyReader{
+public:
+    enum class Format : uint8_t { Ascii, LittleEndian, BigEndian };
+private:
+    const char* position;
+    const char* const end;
+    Format format;
+    bool swap_bytes; // The binary values have the other byte order than the machine
+
+    template<typename T>
+    inline T read_binary() noexcept {
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, position, sizeof(T));
+        if(swap_bytes){
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        position += sizeof(T);
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+public:
+    inline PlyReader(const char* const body, const char* const body_end, const Format body_format) noexcept
+        : position(body), end(body_end), format(body_format) {
+        const uint16_t probe = 1;
+        unsigned char first_byte;
+        std::memcpy(&first_byte, &probe, 1);
+        swap_bytes = format == Format::Ascii? false : (format == Format::LittleEndian) != (first_byte == 1);
+    }
+
+    /// @brief Reads the next value, returns false at the end of the file or for malformed values.
+    inline bool read(const PlyType type, double& value) noexcept {
+        if(format == Format::Ascii){
+            position = skip_mesh_spaces(position, end);
+            const std::from_chars_result result = std::from_chars(position, end, value);
+            position = result.ptr;
+            return result.ec == std::errc();
+        }
+        static constexpr uint8_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+        if(static_cast<size_t>(end - position) < sizes[static_cast<uint8_t>(type)]){
+            return false;
+        }
+        switch(type){
+            case PlyType::Int8:
+                value = read_binary<int8_t>();
+                break;
+            case PlyType::UInt8:
+                value = read_binary<uint8_t>();
+                break;
+            case PlyType::Int16:
+                value = read_binary<int16_t>();
+                break;
+            case PlyType::UInt16:
+                value = read_binary<uint16_t>();
+                break;
+            case PlyType::Int32:
+                value = read_binary<int32_t>();
+                break;
+            case PlyType::UInt32:
+                value = read_binary<uint32_t>();
+                break;
+            case PlyType::Float32:
+                value = read_binary<float>();
+                break;
+            default:
+                value = read_binary<double>();
+        }
+        return true;
+    }
+};
+
+/// @brief Parses a PLY file, error describes the first problem if it fails.
+inline bool parse_ply(const char* const begin, const char* const end, MeshData& mesh, std::string& error) {
+    // Header
+    std::vector<PlyElement> elements;
+    PlyReader::Format format = PlyReader::Format::Ascii;
+    bool has_format = false;
+    const char* line = begin;
+    for(size_t line_number = 1;;line_number++){
+        if(line >= end){
+            error = "missing end_header";
+            return false;
+        }
+        const char* const line_end = mesh_line_end(line, end);
+        std::vector<std::string_view> words;
+        for(const char* position = skip_mesh_spaces(line, line_end);position < line_end;
+            position = skip_mesh_spaces(position, line_end)){
+            const char* const word_end = std::find_if(position, line_end, is_mesh_space);
+            words.emplace_back(position, static_cast<size_t>(word_end - position));
+            position = word_end;
+        }
+        line = mesh_next_line(line, end);
+        if(words.empty() || words[0] == "ply" || words[0] == "comment" || words[0] == "obj_info"){
+            continue;
+        }
+        if(words[0] == "end_header"){
+            break;
+        }
+        bool valid = true;
+        if(words[0] == "format" && words.size() >= 2){
+            has_format = true;
+            if(words[1] == "binary_little_endian"){
+                format = PlyReader::Format::LittleEndian;
+            }else if(words[1] == "binary_big_endian"){
+                format = PlyReader::Format::BigEndian;
+            }else{
+                valid = words[1] == "ascii";
+            }
+        }else if(words[0] == "element" && words.size() == 3){
+            uint64_t count = 0;
+            valid = std::from_chars(words[2].data(), words[2].data() + words[2].size(), count).ec == std::errc();
+            elements.push_back(PlyElement{std::string(words[1]), count, {}});
+        }else if(words[0] == "property" && !elements.empty() && words.size() == 3){
+            elements.back().properties.push_back(PlyProperty{std::string(words[2]), parse_ply_type(words[1]),
+                PlyType::Invalid});
+            valid = elements.back().properties.back().type != PlyType::Invalid;
+        }else if(words[0] == "property" && !elements.empty() && words.size() == 5 && words[1] == "list"){
+            elements.back().properties.push_back(PlyProperty{std::string(words[4]), parse_ply_type(words[3]),
+                parse_ply_type(words[2])});
+            valid = elements.back().properties.back().type != PlyType::Invalid &&
+                elements.back().properties.back().count_type != PlyType::Invalid;
+        }else{
+            valid = false;
+        }
+        if(!valid){
+            error = "header line " + std::to_string(line_number) + ": invalid " + std::string(words[0]);
+            return false;
+        }
+    }
+    if(!has_format){
+        error = "missing format";
+        return false;
+    }
+
+    // Every row takes at least a byte, which bounds the counts of truncated files
+    const uint64_t max_rows = static_cast<uint64_t>(end - line);
+    for(const PlyElement& element : elements){
+        if(element.name == "vertex"){
+            mesh.vertices.reserve(std::min(element.count, max_rows));
+        }else if(element.name == "face"){
+            mesh.indices.reserve(3 * std::min(element.count, max_rows));
+        }
+    }
+
+    // Body
+    PlyReader reader(line, end, format);
+    std::vector<uint32_t> polygon;
+    for(const PlyElement& element : elements){
+        // Role of every property: 0-2 the x, y or z coordinate of a vertex, 3 the vertex
+        // indices of a face, 4 skipped
+        std::vector<uint8_t> roles;
+        for(const PlyProperty& property : element.properties){
+            const bool list = property.count_type != PlyType::Invalid;
+            if(element.name == "vertex" && !list && (property.name == "x" || property.name == "y" || property.name == "z")){
+                roles.push_back(static_cast<uint8_t>(property.name[0] - 'x'));
+            }else if(element.name == "face" && list &&
+                (property.name == "vertex_indices" || property.name == "vertex_index")){
+                roles.push_back(3);
+            }else{
+                roles.push_back(4);
+            }
+        }
+        if(element.name == "vertex" && (std::count(roles.begin(), roles.end(), 0) != 1 ||
+            std::count(roles.begin(), roles.end(), 1) != 1 || std::count(roles.begin(), roles.end(), 2) != 1)){
+            error = "the vertices need one x, y and z property each";
+            return false;
+        }
+        if(element.name == "face" && std::count(roles.begin(), roles.end(), 3) != 1){
+            error = "the faces need one vertex_indices property";
+            return false;
+        }
+        if(element.name == "vertex" && element.count > UINT32_MAX){
+            error = "too many vertices";
+            return false;
+        }
+
+        for(uint64_t row = 0;row < element.count;row++){
+            double coordinates[3] = {};
+            for(size_t i = 0;i < element.properties.size();i++){
+                const PlyProperty& property = element.properties[i];
+                double value;
+                bool valid = true;
+                if(property.count_type == PlyType::Invalid){
+                    valid = reader.read(property.type, value);
+                    if(roles[i] < 3){
+                        coordinates[roles[i]] = value;
+                    }
+                }else{
+                    double count;
+                    valid = reader.read(property.count_type, count) && count >= 0;
+                    polygon.clear();
+                    for(uint64_t item = 0;valid && item < static_cast<uint64_t>(count);item++){
+                        valid = reader.read(property.type, value) && value >= 0 && value < UINT32_MAX;
+                        if(roles[i] == 3){
+                            polygon.push_back(static_cast<uint32_t>(value));
+                        }
+                    }
+                    if(valid && roles[i] == 3){
+                        if(polygon.size() < 3){
+                            error = "face " + std::to_string(row) + " has fewer than three vertices";
+                            return false;
+                        }
+                        add_polygon(mesh, polygon.data(), polygon.size());
+                    }
+                }
+                if(!valid){
+                    error = element.name + " " + std::to_string(row) + ": invalid or truncated " + property.name;
+                    return false;
+                }
+            }
+            if(element.name == "vertex"){
+                mesh.vertices.push_back(MeshVertex{static_cast<float>(coordinates[0]),
+                    static_cast<float>(coordinates[1]), static_cast<float>(coordinates[2])});
+            }
+        }
+    }
+    return check_mesh_indices(mesh, error);
+}
+
+/// @brief Loads the mesh in an OBJ or PLY file into `mesh`, replacing its contents. PLY files
+/// are recognized by their signature, all other files are read as OBJ. Error describes the
+/// problem if it fails.
+inline bool load_mesh(const std::string& path, MeshData& mesh, std::string& error) {
+    mesh = MeshData();
+    MappedFile file;
+    if(!file.open(path)){
+        error = "can't open " + path;
+        return false;
+    }
+    const char* const begin = reinterpret_cast<const char*>(file.data());
+    const char* const end = begin + file.size();
+    const bool ply = file.size() >= 4 && std::memcmp(begin, "ply", 3) == 0 && is_mesh_space(begin[3]);
+    if(!(ply? parse_ply(begin, end, mesh, error) : parse_obj(begin, end, mesh, error))){
+        error = path + ": " + error;
+        return false;
+    }
+    if(mesh.indices.empty()){
+        error = path + ": no faces";
+        return false;
+    }
+    return true;
+}
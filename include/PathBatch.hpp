@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Ray.hpp"
+#include "Color.hpp"
+#include "Hittable.hpp"
+#include "Sampler.hpp"
+
+/// @brief State of a batch of light paths for the wavefront integrator, in flat arrays
+/// indexed by path. Paths still bouncing are listed in `active`.
+struct PathBatch{
+    std::vector<Ray> rays;              // Ray each path continues with
+    std::vector<Color> throughput;      // Product of the attenuations along each path
+    std::vector<Sampler> samplers;      // Sample values of each path
+    std::vector<uint32_t> pixels;       // Index of the tile pixel each path contributes to
+    std::vector<HitRecord> hits;        // Nearest hit of each path's current ray
+    std::vector<uint32_t> active;       // Paths that still have to be traced
+    std::vector<uint32_t> grouped;      // Active paths that hit something, grouped by material type
+    std::vector<uint32_t> type_offsets; // Start of every material type in `grouped`
+
+    inline void resize(const size_t path_count) {
+        rays.resize(path_count);
+        throughput.resize(path_count);
+        samplers.resize(path_count);
+        pixels.resize(path_count);
+        hits.resize(path_count);
+        active.reserve(path_count);
+        grouped.resize(path_count);
+    }
+};
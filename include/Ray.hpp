@@ -1,5 +1,7 @@
 #pragma once
 
+#include <type_traits>
+
 #include "Vec3.hpp"
 
 class Ray{
@@ -8,8 +10,7 @@ private:
     Vec3 dir;
 public:
     inline constexpr Ray() noexcept : orig(), dir() {}
-    inline Ray(const Point3 origin, const Vec3 direction) noexcept : orig(origin), dir(direction) {}
-    inline virtual ~Ray() noexcept {}
+    inline constexpr Ray(const Point3 origin, const Vec3 direction) noexcept : orig(origin), dir(direction) {}
 
     inline constexpr const Point3& origin() const noexcept {
         return orig;
@@ -19,7 +20,9 @@ public:
         return dir;
     }
 
-    inline const Point3 at(const double time) const noexcept {
+    inline constexpr Point3 at(const Real time) const noexcept {
         return orig + time * dir;
     }
 };
+
+static_assert(std::is_trivially_copyable_v<Ray>, "Ray must stay a plain value type");
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "ImageEncoder.hpp"
+#include "Sampler.hpp"
+
+/// Algorithms Camera::render can compute the light of the samples with.
+enum class Integrator : uint8_t {
+    Recursive, // Trace one path at a time, recursing once per bounce
+    Wavefront  // Trace batches of paths one bounce at a time, grouped by material type
+};
+
+/// How the render calls into the objects and materials of a scene, see dispatch_scene.
+enum class Dispatch : uint8_t {
+    Closed, // Render instantiated for the BVH and the built-in materials, so the calls can be inlined
+    Virtual // Virtual calls through Hittable and Material, for any object and material type
+};
+
+/// @brief Options controlling how Camera::render distributes its work.
+struct RenderSettings{
+    uint32_t thread_count = 0; // Number of render threads, 0 uses every hardware thread
+    uint16_t tile_size = 16;   // Width and height of the square tiles handed to the threads
+    uint64_t seed = 0;         // Seed the random stream of every sample is derived from
+    uint32_t frame = 0;        // Frame number, gives every frame of an animation its own streams
+    SamplePattern sample_pattern = SamplePattern::Sobol; // How the samples of a pixel are placed
+    Integrator integrator = Integrator::Recursive;
+    Dispatch dispatch = Dispatch::Closed;
+    uint32_t wavefront_batch_size = 1 << 14; // Paths the wavefront integrator traces at once
+    uint8_t roulette_depth = 3; // Bounces before Russian roulette may end a path, 0 disables it
+    ImageFormat format = ImageFormat::P6;    // Format of the image written by Camera::render
+    std::chrono::milliseconds progress_interval{250}; // Minimum time between progress reports
+
+    // Adaptive sampling, only used by the recursive integrator. Every pixel gets at least
+    // min_samples and at most the camera's samples_per_pixel samples. Sampling a pixel stops
+    // once the 95% confidence interval of its mean luminance is narrower than +-noise_threshold.
+    bool adaptive = false;
+    uint16_t min_samples = 16;
+    double noise_threshold = 0.01;
+    std::string sample_map_path; // If not empty, the sample count map is written to this file
+
+    std::string tile_heat_map_path; // If not empty, an image of the time per tile is written to this file
+
+    // Shards: a render can be restricted to a range of tiles and a range of the sample indices
+    // of every pixel, and be written as a shard to merge with the other parts of the frame.
+    // Sample ranges don't apply to adaptive sampling, which needs all samples of a pixel.
+    uint32_t tile_begin = 0, tile_end = UINT32_MAX;
+    uint16_t sample_begin = 0, sample_end = UINT16_MAX;
+    std::string shard_path; // If not empty, the render is written to this file as a shard instead of an image
+
+    // Streaming: if band_rows isn't 0, Camera::render renders the image in bands of at least
+    // band_rows full rows, rounded up to whole tiles, and writes every band as soon as it is
+    // done, so only one band of the image is in memory. What needs the whole image, denoising,
+    // feature images, sample and tile heat maps, shards and checkpoints, isn't available then.
+    uint32_t band_rows = 0;
+
+    // Checkpoints: if checkpoint_path is not empty, the render is saved there as a shard every
+    // checkpoint_interval and when it is done, so it can be resumed after it was stopped, or
+    // continued to more samples per pixel later.
+    std::string checkpoint_path;
+    std::chrono::seconds checkpoint_interval{300};
+
+    // Denoising: the camera rays of the first feature_samples samples of every pixel are traced
+    // to their first hit for the albedo, normal and depth of the pixel, which guide the
+    // denoiser and are written to the files of the paths that aren't empty. The image is
+    // denoised before it is written if denoise_iterations isn't 0, shards never are.
+    uint8_t denoise_iterations = 0; // Filter passes, every pass doubles the filter radius
+    double denoise_strength = 2;    // Standard deviations of noise the lighting of averaged pixels may differ by
+    uint16_t feature_samples = 8;
+    std::string albedo_path, normal_path, depth_path;
+};
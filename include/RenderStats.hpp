@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counters on the hot paths are only compiled in with RAY_TRACER_STATS defined. Without it,
+// RAY_TRACER_STAT discards its statement and the statistics stay zero, except for the ray
+// counts, which take one increment per ray and are always kept for the ray rate.
+#ifdef RAY_TRACER_STATS
+#define RAY_TRACER_STAT(statement) (statement)
+#else
+#define RAY_TRACER_STAT(statement) ((void)0)
+#endif
+
+/// @brief Counters describing the work of a render. Every thread counts into its own
+/// instance, the instances are merged when the render is done.
+struct RenderStats{
+    static constexpr uint8_t max_material_types = 16; // Later types are counted with the last one
+
+    uint64_t primary_rays = 0;         // Camera rays traced into the scene
+    uint64_t secondary_rays = 0;       // Scattered rays traced into the scene
+    uint64_t primitive_tests = 0;      // Ray/primitive intersection tests
+    uint64_t node_visits = 0;          // Acceleration structure nodes tested
+    uint64_t roulette_terminations = 0; // Paths ended by Russian roulette
+    std::array<uint64_t, max_material_types> material_hits{}; // Scatter calls by material type
+    std::array<uint64_t, 256> path_lengths{}; // Paths by the number of bounces they made
+    std::vector<double> tile_seconds;         // Time spent on every tile, always measured
+
+    inline void merge(const RenderStats& other) noexcept {
+        primary_rays += other.primary_rays;
+        secondary_rays += other.secondary_rays;
+        primitive_tests += other.primitive_tests;
+        node_visits += other.node_visits;
+        roulette_terminations += other.roulette_terminations;
+        for(size_t i = 0;i < material_hits.size();i++){
+            material_hits[i] += other.material_hits[i];
+        }
+        for(size_t i = 0;i < path_lengths.size();i++){
+            path_lengths[i] += other.path_lengths[i];
+        }
+    }
+
+    inline void count_material_hit(const uint8_t type) noexcept {
+        material_hits[type < max_material_types? type : max_material_types - 1]++;
+    }
+
+    inline uint64_t rays() const noexcept {
+        return primary_rays + secondary_rays;
+    }
+
+    /// @brief Prints a summary of the render, `material_names` names the material types.
+    inline void print(std::ostream& out, const double seconds, [[maybe_unused]] const uint8_t max_depth,
+        [[maybe_unused]] const std::vector<std::string>& material_names) const {
+        const double ray_count = static_cast<double>(rays());
+        out << "Rendered in " << seconds << " seconds, " << ray_count / seconds / 1e6 << " Mrays/s";
+#ifdef RAY_TRACER_STATS
+        out << "\n  rays: " << primary_rays << " primary, " << secondary_rays << " secondary\n"
+            << "  per ray: " << primitive_tests / ray_count << " primitive tests, "
+            << node_visits / ray_count << " node visits\n"
+            << "  Russian roulette: " << roulette_terminations << " paths ended\n"
+            << "  material hits:";
+        for(size_t type = 0;type < material_hits.size();type++){
+            if(material_hits[type] > 0){
+                out << ' ' << (type < material_names.size()? material_names[type] : "other") << '='
+                    << material_hits[type];
+            }
+        }
+
+        uint64_t paths = 0, bounces = 0;
+        for(size_t length = 0;length <= max_depth;length++){
+            paths += path_lengths[length];
+            bounces += length * path_lengths[length];
+        }
+        out << "\n  path lengths (max " << static_cast<uint16_t>(max_depth) << ", mean "
+            << static_cast<double>(bounces) / std::max<uint64_t>(1, paths) << "):";
+        for(size_t length = 0;length <= max_depth;length++){
+            if(path_lengths[length] > 0){
+                out << ' ' << length << '=' << path_lengths[length];
+            }
+        }
+#endif
+        out << '\n';
+    }
+};
+
+/// @brief Returns the statistics the calling thread counts into.
+inline RenderStats& thread_stats() noexcept {
+    thread_local RenderStats stats;
+    return stats;
+}
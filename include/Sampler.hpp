@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+
+#include "util.hpp"
+#include "Vec3.hpp"
+
+/// Patterns the samples of a pixel can be placed in, see Sampler.
+enum class SamplePattern : uint8_t {
+    Independent, // Independent uniform random values
+    Stratified,  // One jittered value per stratum, the strata in a random order per pixel and dimension
+    Sobol,       // Owen-scrambled Sobol points, the point order shuffled per pixel and dimension
+    BlueNoise    // Rank-1 lattice, shifted per pixel by a dither that leaves blue noise between pixels
+};
+
+/// @brief Two sample values, used together, like the offset of a ray in its pixel.
+struct SamplePoint{
+    double u, v;
+};
+
+/// @brief Draws the values of one sample of one pixel, dimension by dimension: the offset in the
+/// pixel, the point on the lens, then what every bounce needs. Like RandomStream, every value
+/// only depends on the seed, frame, pixel, sample index and dimension, so a sample is the same
+/// no matter how the work is scheduled, split into shards or resumed.
+/// Other than independent values, the patterns place the samples of a pixel relative to each
+/// other, so its error shrinks faster with the sample count. Sobol points do so for every
+/// prefix of the samples. Stratified and BlueNoise samples do so for the samples_per_pixel
+/// samples of the pixel as a whole, resuming them to another sample count loses that.
+class Sampler{
+private:
+    static constexpr double golden = 0.6180339887498949;  // 1D rank-1 generator, 1 / phi
+    static constexpr double plastic_1 = 0.7548776662466927; // 2D rank-1 generators, 1 / p and 1 / p^2
+    static constexpr double plastic_2 = 0.5698402909980532; // of the plastic number p
+
+    RandomStream stream;    // Independent values
+    uint64_t frame_key;     // Seed and frame, shared by all pixels
+    uint64_t pixel_key;     // Seed, frame and pixel
+    uint32_t x, y;
+    uint32_t sample, sample_count;
+    uint32_t dimension = 0; // Next dimension of the other patterns
+    SamplePattern pattern;
+
+    static inline constexpr uint32_t reverse_bits(uint32_t value) noexcept {
+        value = (value << 16) | (value >> 16);
+        value = ((value & 0x00FF00FFu) << 8) | ((value & 0xFF00FF00u) >> 8);
+        value = ((value & 0x0F0F0F0Fu) << 4) | ((value & 0xF0F0F0F0u) >> 4);
+        value = ((value & 0x33333333u) << 2) | ((value & 0xCCCCCCCCu) >> 2);
+        return ((value & 0x55555555u) << 1) | ((value & 0xAAAAAAAAu) >> 1);
+    }
+
+    /// @brief Laine-Karras permutation, a hash in which every bit only depends on the bits below
+    /// it. Applied to bit-reversed values, it is an Owen scrambling (Burley 2020).
+    static inline constexpr uint32_t laine_karras(uint32_t value, const uint32_t seed) noexcept {
+        value += seed;
+        value ^= value * 0x6C50B47Cu;
+        value ^= value * 0xB82F1E52u;
+        value ^= value * 0xC7AFE638u;
+        value ^= value * 0x8D22F6E6u;
+        return value;
+    }
+
+    /// @brief Owen scrambling of the bits of a value: every bit is flipped depending on the
+    /// bits above it.
+    static inline constexpr uint32_t nested_uniform_scramble(const uint32_t value, const uint32_t seed) noexcept {
+        return reverse_bits(laine_karras(reverse_bits(value), seed));
+    }
+
+    /// @brief Returns the second dimension of the Sobol point with the index with its bits
+    /// reversed, the first dimension being the index itself reversed. The generator matrix is
+    /// linear over GF(2), so it is applied one byte of the index at a time with tables.
+    static inline uint32_t reversed_sobol_second(const uint32_t index) noexcept {
+        using Tables = std::array<std::array<uint32_t, 256>, 4>;
+        static constexpr Tables tables = []{
+            std::array<uint32_t, 32> columns{};
+            for(uint32_t bit = 0, direction = 1u << 31;bit < 32;bit++, direction ^= direction >> 1){
+                columns[bit] = reverse_bits(direction);
+            }
+            Tables entries{};
+            for(uint32_t byte = 0;byte < 4;byte++){
+                for(uint32_t value = 0;value < 256;value++){
+                    for(uint32_t bit = 0;bit < 8;bit++){
+                        if(value >> bit & 1){
+                            entries[byte][value] ^= columns[8 * byte + bit];
+                        }
+                    }
+                }
+            }
+            return entries;
+        }();
+        return tables[0][index & 0xFF] ^ tables[1][index >> 8 & 0xFF] ^ tables[2][index >> 16 & 0xFF]
+            ^ tables[3][index >> 24];
+    }
+
+    /// @brief Returns the position of `index` in a random permutation of [0, length) chosen by
+    /// the seed, without storing the permutation (Kensler 2013).
+    static inline constexpr uint32_t permute(uint32_t index, const uint32_t length, const uint32_t seed) noexcept {
+        uint32_t mask = length - 1;
+        mask |= mask >> 1;
+        mask |= mask >> 2;
+        mask |= mask >> 4;
+        mask |= mask >> 8;
+        mask |= mask >> 16;
+        do{
+            index ^= seed;
+            index *= 0xE170893Du;
+            index ^= seed >> 16;
+            index ^= (index & mask) >> 4;
+            index ^= seed >> 8;
+            index *= 0x0929EB3Fu;
+            index ^= seed >> 23;
+            index ^= (index & mask) >> 1;
+            index *= 1 | seed >> 27;
+            index *= 0x6935FA69u;
+            index ^= (index & mask) >> 11;
+            index *= 0x74DCB303u;
+            index ^= (index & mask) >> 2;
+            index *= 0x9E501CC3u;
+            index ^= (index & mask) >> 2;
+            index *= 0xC860A3DFu;
+            index &= mask;
+            index ^= index >> 5;
+        }while(index >= length);
+        return (index + seed) % length;
+    }
+
+    static inline constexpr double to_unit(const uint64_t bits) noexcept {
+        return static_cast<double>(bits >> 11) * 0x1.0p-53;
+    }
+
+    static inline constexpr double to_unit(const uint32_t bits) noexcept {
+        return bits * 0x1.0p-32;
+    }
+
+    static inline double fraction(const double value) noexcept {
+        return value - std::floor(value);
+    }
+
+    /// @brief Returns a hash of the key and the next dimension, which seeds what the pattern
+    /// does in that dimension.
+    inline uint64_t next_dimension(const uint64_t key) noexcept {
+        return mix_seed(key, dimension++);
+    }
+public:
+    inline Sampler() noexcept
+        : frame_key(0), pixel_key(0), x(0), y(0), sample(0), sample_count(1), pattern(SamplePattern::Independent) {}
+
+    /// @brief Returns the sampler of one sample of the pixel at x, y in a frame whose pixels
+    /// take `samples` samples, the pixel's index being `pixel`.
+    inline Sampler(const SamplePattern sample_pattern, const uint64_t seed, const uint32_t frame,
+        const uint32_t pixel_x, const uint32_t pixel_y, const uint64_t pixel, const uint32_t sample_index,
+        const uint32_t samples) noexcept
+        : stream(RandomStream::for_sample(seed, frame, pixel, sample_index)),
+        frame_key(mix_seed(seed, frame)), pixel_key(mix_seed(frame_key, pixel)), x(pixel_x), y(pixel_y),
+        sample(sample_index), sample_count(std::max<uint32_t>(samples, 1)), pattern(sample_pattern) {
+        // Samples beyond the count, as an adaptive render may never take, fall back to independent values
+        if(sample >= sample_count && (pattern == SamplePattern::Stratified || pattern == SamplePattern::BlueNoise)){
+            pattern = SamplePattern::Independent;
+        }
+    }
+
+    /// @brief Returns a value in [0, 1) of the next dimension.
+    inline double next_1d() noexcept {
+        switch(pattern){
+            case SamplePattern::Stratified: {
+                const uint64_t hash = next_dimension(pixel_key);
+                const uint32_t stratum = permute(sample, sample_count, static_cast<uint32_t>(hash));
+                return (stratum + to_unit(mix_seed(hash, sample))) / sample_count;
+            }
+            case SamplePattern::Sobol: {
+                const uint64_t hash = next_dimension(pixel_key);
+                const uint32_t index = nested_uniform_scramble(sample, static_cast<uint32_t>(hash));
+                return to_unit(reverse_bits(laine_karras(index, static_cast<uint32_t>(hash >> 32))));
+            }
+            case SamplePattern::BlueNoise: {
+                const uint64_t hash = next_dimension(frame_key);
+                const uint32_t index = permute(sample, sample_count, static_cast<uint32_t>(hash));
+                const double dither = x * plastic_1 + y * plastic_2;
+                return fraction(to_unit(hash) + dither + index * golden);
+            }
+            default:
+                return random_double(stream);
+        }
+    }
+
+    /// @brief Returns a point in [0, 1)^2 of the next two dimensions.
+    inline SamplePoint next_2d() noexcept {
+        switch(pattern){
+            case SamplePattern::Stratified: {
+                const uint64_t hash = next_dimension(pixel_key);
+                dimension++;
+                const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(sample_count))));
+                const uint32_t rows = (sample_count + columns - 1) / columns;
+                const uint32_t stratum = permute(sample, columns * rows, static_cast<uint32_t>(hash));
+                const uint64_t jitter = mix_seed(hash, sample);
+                return SamplePoint{(stratum % columns + to_unit(static_cast<uint32_t>(jitter))) / columns,
+                    (stratum / columns + to_unit(static_cast<uint32_t>(jitter >> 32))) / rows};
+            }
+            case SamplePattern::Sobol: {
+                const uint64_t hash = next_dimension(pixel_key);
+                const uint64_t scrambles = next_dimension(pixel_key);
+                const uint32_t index = nested_uniform_scramble(sample, static_cast<uint32_t>(hash));
+                return SamplePoint{to_unit(reverse_bits(laine_karras(index, static_cast<uint32_t>(scrambles)))),
+                    to_unit(reverse_bits(laine_karras(reversed_sobol_second(index),
+                    static_cast<uint32_t>(scrambles >> 32))))};
+            }
+            case SamplePattern::BlueNoise: {
+                const uint64_t hash = next_dimension(frame_key);
+                const uint64_t shift = next_dimension(frame_key);
+                const uint32_t index = permute(sample, sample_count, static_cast<uint32_t>(hash));
+                return SamplePoint{
+                    fraction(to_unit(static_cast<uint32_t>(shift)) + x * plastic_1 + y * plastic_2 + index * plastic_1),
+                    fraction(to_unit(static_cast<uint32_t>(shift >> 32)) + x * plastic_2 + y * plastic_1 + index * plastic_2)};
+            }
+            default: {
+                const double u = random_double(stream);
+                return SamplePoint{u, random_double(stream)};
+            }
+        }
+    }
+
+    /// @brief Returns a random unit vector, uniform over the sphere.
+    inline Vec3 unit_vector() noexcept {
+        const SamplePoint point = next_2d();
+        const double z = 1 - 2 * point.u;
+        const double radius = std::sqrt(std::max(0.0, 1 - z * z));
+        const double phi = 2 * M_PI * point.v;
+        return Vec3(radius * std::cos(phi), radius * std::sin(phi), z);
+    }
+
+    /// @brief Returns a random point in the unit disk in the x, y plane, uniform over its area,
+    /// with the concentric mapping of Shirley and Chiu, which keeps strata compact.
+    inline Vec3 in_unit_disk() noexcept {
+        const SamplePoint point = next_2d();
+        const double a = 2 * point.u - 1, b = 2 * point.v - 1;
+        if(a == 0 && b == 0){
+            return Vec3(0, 0, 0);
+        }
+        const double radius = std::fabs(a) > std::fabs(b)? a : b;
+        const double phi = std::fabs(a) > std::fabs(b)? M_PI / 4 * (b / a) : M_PI / 2 - M_PI / 4 * (a / b);
+        return Vec3(radius * std::cos(phi), radius * std::sin(phi), 0);
+    }
+};
+
+/// @brief Parses a pattern name (independent, stratified, sobol or blue-noise), returns false
+/// for unknown names.
+inline bool parse_sample_pattern(const std::string_view name, SamplePattern& pattern) noexcept {
+    if(name == "independent"){
+        pattern = SamplePattern::Independent;
+    }else if(name == "stratified"){
+        pattern = SamplePattern::Stratified;
+    }else if(name == "sobol"){
+        pattern = SamplePattern::Sobol;
+    }else if(name == "blue-noise"){
+        pattern = SamplePattern::BlueNoise;
+    }else{
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BVH.hpp"
+#include "Camera.hpp"
+#include "Instance.hpp"
+#include "MappedFile.hpp"
+#include "MaterialTable.hpp"
+#include "Sphere.hpp"
+#include "HittableList.hpp"
+#include "TriangleMesh.hpp"
+
+/// @brief Parameters of the Camera constructor, so a scene can carry the camera it is viewed
+/// with. The defaults are the camera of the demo scene.
+struct CameraParameters{
+    double aspect_ratio = 16.0 / 9.0;
+    uint32_t image_width = 1200;
+    uint16_t samples_per_pixel = 500;
+    uint8_t max_depth = 50;
+    double vfov = 20;
+    Point3 look_from = Point3(13, 2, 3);
+    Point3 look_at = Point3(0, 0, 0);
+    Vec3 vector_up = Vec3(0, 1, 0);
+    double defocus_angle = 0.6;
+    double focus_dist = 10;
+
+    inline Camera camera() const noexcept {
+        return Camera(aspect_ratio, image_width, samples_per_pixel, max_depth, vfov, look_from, look_at,
+            vector_up, defocus_angle, focus_dist);
+    }
+};
+
+/// @brief Mesh file a scene file places in the scene, scaled around its origin and then moved
+/// to the position. Kept so the scene can be saved with it.
+struct MeshPlacement{
+    std::string path;
+    uint32_t material;
+    Point3 position;
+    double scale;
+};
+
+/// @brief Owns everything a scene is made of: the camera parameters, the material table,
+/// the sphere storage, triangle meshes and the instances of shared geometry. Objects refer to
+/// materials by index, so building a scene allocates no object on its own.
+struct Scene{
+    CameraParameters camera;
+    MaterialTable materials;
+    SphereStorage spheres;
+    std::shared_ptr<const MappedFile> mapping; // Scene file the sphere storage views, if any
+    std::deque<BVH> prototypes;     // Geometry shared by instances, the deques keep addresses stable
+    std::deque<TriangleMesh> meshes; // Meshes, placed in the scene by instances
+    std::deque<Instance> instances; // Instances of prototypes or of any other Hittable
+    std::vector<MeshPlacement> mesh_placements; // Meshes the scene file placed, see SceneFile.hpp
+
+    /// @brief Constructs a material of type T and returns the index to refer to it with.
+    template<typename T, typename... Args>
+    inline uint32_t add_material(Args&&... args) {
+        return materials.add<T>(std::forward<Args>(args)...);
+    }
+
+    inline uint32_t add_sphere(const Point3 center, const double radius, const uint32_t material) {
+        return spheres.add(center, radius, material);
+    }
+
+    /// @brief Builds an acceleration structure over geometry that instances can share.
+    /// The spheres of the geometry are copied, its other objects must outlive the scene.
+    inline const BVH& add_prototype(const HittableList& geometry) {
+        return prototypes.emplace_back(geometry);
+    }
+
+    /// @brief Builds a mesh of one material with its BVH, which instances can place in the scene.
+    inline const TriangleMesh& add_mesh(MeshData&& data, const uint32_t material) {
+        return meshes.emplace_back(std::move(data), material);
+    }
+
+    /// @brief Places the object in the scene through the transform. The object, usually a
+    /// prototype, must outlive the scene.
+    inline const Instance& add_instance(const Hittable& object, const Transform& transform) {
+        return instances.emplace_back(object, transform);
+    }
+
+    /// @brief Returns a list viewing every object of the scene.
+    inline HittableList world() const {
+        HittableList list(spheres);
+        list.objects.reserve(instances.size());
+        for(const Instance& instance : instances){
+            list.add(instance);
+        }
+        return list;
+    }
+};
+
+/// @brief Calls `render(world, materials)` with the BVH of a scene and its materials typed for
+/// the dispatch, so the render is instantiated for them. Closed dispatch passes the BVH itself
+/// and, if all materials are built in, a BuiltinMaterialTable copy of them, so the camera calls
+/// the intersection and scatter code directly. Virtual dispatch, and the materials of scenes
+/// with other material types, go through the Hittable and Material interfaces.
+template<typename Render>
+inline void dispatch_scene(const Dispatch dispatch, const BVH& world, const MaterialTable& materials,
+    Render&& render) {
+    if(dispatch == Dispatch::Virtual){
+        render(static_cast<const Hittable&>(world), materials);
+        return;
+    }
+    BuiltinMaterialTable builtin_materials;
+    if(builtin_materials.assign(materials)){
+        render(world, builtin_materials);
+    }else{
+        render(world, materials);
+    }
+}
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "MappedFile.hpp"
+#include "MeshLoader.hpp"
+#include "Scene.hpp"
+
+// Scene files come in two forms with the same contents: camera parameters, materials and spheres.
+//
+// The text form has one statement per line, `#` starts a comment:
+//   aspect_ratio <value>, image_width <pixels>, samples_per_pixel <count>, max_depth <bounces>,
+//   vfov <degrees>, look_from <x y z>, look_at <x y z>, vector_up <x y z>,
+//   defocus_angle <degrees>, focus_dist <distance>
+//   lambertian <name> <r g b>
+//   metal <name> <r g b> <fuzz>
+//   dielectric <name> <refraction index>
+//   sphere <x y z> <radius> <material name>
+//   mesh <OBJ or PLY file> <material name> <x y z> <scale>   the mesh is scaled, then moved to x y z
+//
+// The binary form is a SceneFileHeader followed by the material records and the sphere
+// columns of SphereStorage, every section starting at a multiple of 64 bytes. It is
+// memory-mapped and the spheres are used in place, loading it only reads their centers,
+// radii and materials to validate them.
+// Only the text form stores the meshes a scene file placed, saving a scene with meshes or
+// instances in binary form fails. Instances built at run time are never stored.
+
+/// @brief Header of a binary scene file, in the byte order of the machine that wrote it.
+struct SceneFileHeader{
+    static constexpr char signature[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t native_byte_order = 0x01020304;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t material_count;
+    uint64_t sphere_count;
+    double aspect_ratio, vfov, defocus_angle, focus_dist;
+    double look_from[3], look_at[3], vector_up[3];
+    uint16_t image_width, samples_per_pixel; // Low 16 bits of the width
+    uint8_t max_depth;
+    uint8_t reserved;
+    uint16_t image_width_high; // High 16 bits of the width, 0 in files from before wider images
+};
+
+/// @brief Offsets of the sections of a binary scene file.
+struct SceneFileLayout{
+    static constexpr uint64_t alignment = 64;
+
+    uint64_t materials, center_x, center_y, center_z, radius, sphere_materials, size;
+
+    static constexpr uint64_t align(const uint64_t offset) noexcept {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    inline explicit SceneFileLayout(const SceneFileHeader& header) noexcept {
+        const uint64_t column_bytes = align(header.sphere_count * sizeof(double));
+        materials = align(sizeof(SceneFileHeader));
+        center_x = align(materials + header.material_count * sizeof(MaterialRecord));
+        center_y = center_x + column_bytes;
+        center_z = center_y + column_bytes;
+        radius = center_z + column_bytes;
+        sphere_materials = radius + column_bytes;
+        size = sphere_materials + header.sphere_count * sizeof(uint32_t);
+    }
+};
+
+/// @brief Returns whether a material from a scene file can be rendered: its kind must be
+/// known, albedos finite and not negative, fuzz finite and refraction indices positive.
+inline bool valid_material(const MaterialRecord& record, std::string& error) {
+    const double* const p = record.parameters;
+    switch(record.kind){
+        case MaterialKind::Lambertian:
+        case MaterialKind::Metal:
+            for(uint8_t component = 0;component < 3;component++){
+                if(!std::isfinite(p[component]) || p[component] < 0){
+                    error = "albedo must be finite and not negative";
+                    return false;
+                }
+            }
+            if(record.kind == MaterialKind::Metal && !std::isfinite(p[3])){
+                error = "fuzz must be finite";
+                return false;
+            }
+            return true;
+        case MaterialKind::Dielectric:
+            if(!std::isfinite(p[0]) || p[0] <= 0){
+                error = "refraction index must be finite and positive";
+                return false;
+            }
+            return true;
+    }
+    error = "unknown material kind " + std::to_string(static_cast<uint32_t>(record.kind));
+    return false;
+}
+
+/// @brief Returns whether a sphere from a scene file can be rendered: its center must be
+/// finite and its radius finite and positive.
+inline bool valid_sphere(const Point3& center, const double radius, std::string& error) {
+    if(!std::isfinite(center.x()) || !std::isfinite(center.y()) || !std::isfinite(center.z())){
+        error = "sphere center must be finite";
+        return false;
+    }
+    if(!std::isfinite(radius) || radius <= 0){
+        error = "sphere radius must be finite and positive";
+        return false;
+    }
+    return true;
+}
+
+/// @brief Returns whether the camera of a scene file can render an image: the image width,
+/// samples per pixel and maximum depth must not be 0, the aspect ratio finite and positive.
+inline bool valid_camera(const CameraParameters& camera, std::string& error) {
+    if(camera.image_width == 0 || camera.samples_per_pixel == 0 || camera.max_depth == 0){
+        error = "image_width, samples_per_pixel and max_depth must not be 0";
+        return false;
+    }
+    if(!std::isfinite(camera.aspect_ratio) || camera.aspect_ratio <= 0){
+        error = "aspect_ratio must be finite and positive";
+        return false;
+    }
+    return true;
+}
+
+/// @brief Loads a scene in text form, error describes the first problem if it fails.
+/// Material names must be unique, and a line must not go on after its statement.
+inline bool load_scene_text(std::istream& in, Scene& scene, std::string& error) {
+    std::unordered_map<std::string, uint32_t> material_names;
+    CameraParameters& camera = scene.camera;
+    std::string line;
+    for(size_t line_number = 1;std::getline(in, line);line_number++){
+        std::istringstream statement(line.substr(0, line.find('#')));
+        std::string keyword;
+        if(!(statement >> keyword)){
+            continue;
+        }
+
+        double x = 0, y = 0, z = 0, w = 0;
+        unsigned value = 0;
+        std::string name;
+        bool valid;
+        if(keyword == "sphere"){
+            valid = static_cast<bool>(statement >> x >> y >> z >> w >> name);
+            const auto material = material_names.find(name);
+            if(valid && material == material_names.end()){
+                error = "line " + std::to_string(line_number) + ": unknown material " + name;
+                return false;
+            }
+            if(valid && !valid_sphere(Point3(x, y, z), w, error)){
+                error = "line " + std::to_string(line_number) + ": " + error;
+                return false;
+            }
+            if(valid){
+                scene.add_sphere(Point3(x, y, z), w, material->second);
+            }
+        }else if(keyword == "mesh"){
+            std::string path;
+            valid = static_cast<bool>(statement >> path >> name >> x >> y >> z >> w) && w != 0;
+            const auto material = material_names.find(name);
+            if(valid && material == material_names.end()){
+                error = "line " + std::to_string(line_number) + ": unknown material " + name;
+                return false;
+            }
+            if(valid){
+                MeshData data;
+                if(!load_mesh(path, data, error)){
+                    error = "line " + std::to_string(line_number) + ": " + error;
+                    return false;
+                }
+                const TriangleMesh& mesh = scene.add_mesh(std::move(data), material->second);
+                scene.add_instance(mesh, Transform::translation(Vec3(x, y, z)) * Transform::scaling(w));
+                scene.mesh_placements.push_back(MeshPlacement{path, material->second, Point3(x, y, z), w});
+            }
+        }else if(keyword == "lambertian" || keyword == "metal" || keyword == "dielectric"){
+            MaterialRecord record;
+            if(keyword == "lambertian"){
+                valid = static_cast<bool>(statement >> name >> x >> y >> z);
+                record = MaterialRecord{MaterialKind::Lambertian, 0, {x, y, z}};
+            }else if(keyword == "metal"){
+                valid = static_cast<bool>(statement >> name >> x >> y >> z >> w);
+                record = MaterialRecord{MaterialKind::Metal, 0, {x, y, z, w}};
+            }else{
+                valid = static_cast<bool>(statement >> name >> x);
+                record = MaterialRecord{MaterialKind::Dielectric, 0, {x}};
+            }
+            if(valid && material_names.count(name) != 0){
+                error = "line " + std::to_string(line_number) + ": material " + name + " is already defined";
+                return false;
+            }
+            if(valid && !valid_material(record, error)){
+                error = "line " + std::to_string(line_number) + ": " + error;
+                return false;
+            }
+            if(valid){
+                material_names.emplace(name, scene.materials.add(record));
+            }
+        }else if(keyword == "look_from" || keyword == "look_at" || keyword == "vector_up"){
+            valid = static_cast<bool>(statement >> x >> y >> z);
+            (keyword == "look_from"? camera.look_from : keyword == "look_at"? camera.look_at :
+                camera.vector_up) = Vec3(x, y, z);
+        }else if(keyword == "image_width" || keyword == "samples_per_pixel" || keyword == "max_depth"){
+            valid = static_cast<bool>(statement >> value) && value > 0 &&
+                value <= (keyword == "max_depth"? 255u : keyword == "image_width"? UINT32_MAX : 65535u);
+            if(keyword == "image_width"){
+                camera.image_width = value;
+            }else if(keyword == "samples_per_pixel"){
+                camera.samples_per_pixel = static_cast<uint16_t>(value);
+            }else{
+                camera.max_depth = static_cast<uint8_t>(value);
+            }
+        }else if(keyword == "aspect_ratio" || keyword == "vfov" || keyword == "defocus_angle" ||
+            keyword == "focus_dist"){
+            valid = static_cast<bool>(statement >> x) && (keyword != "aspect_ratio" || (std::isfinite(x) && x > 0));
+            (keyword == "aspect_ratio"? camera.aspect_ratio : keyword == "vfov"? camera.vfov :
+                keyword == "defocus_angle"? camera.defocus_angle : camera.focus_dist) = x;
+        }else{
+            error = "line " + std::to_string(line_number) + ": unknown statement " + keyword;
+            return false;
+        }
+        if(!valid){
+            error = "line " + std::to_string(line_number) + ": invalid " + keyword;
+            return false;
+        }
+        if(!(statement >> std::ws).eof()){
+            error = "line " + std::to_string(line_number) + ": unexpected text after " + keyword;
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief Loads a binary scene file, the spheres keep viewing the mapped file in place.
+inline bool load_scene_binary(const std::shared_ptr<const MappedFile>& file, Scene& scene,
+    std::string& error) {
+    SceneFileHeader header;
+    if(file->size() < sizeof(header)){
+        error = "truncated header";
+        return false;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if(std::memcmp(header.magic, SceneFileHeader::signature, sizeof(header.magic)) != 0 ||
+        header.version != SceneFileHeader::current_version){
+        error = "not a binary scene file of version " + std::to_string(SceneFileHeader::current_version);
+        return false;
+    }
+    if(header.byte_order != SceneFileHeader::native_byte_order){
+        error = "written on a machine of another byte order";
+        return false;
+    }
+    if(header.sphere_count >= UINT32_MAX || header.material_count >= UINT32_MAX ||
+        SceneFileLayout(header).size > file->size()){
+        error = "truncated file";
+        return false;
+    }
+    if(scene.materials.size() != 0 || scene.spheres.size() != 0){
+        error = "binary scenes can only be loaded into an empty scene";
+        return false;
+    }
+    const SceneFileLayout layout(header);
+
+    CameraParameters& camera = scene.camera;
+    camera.aspect_ratio = header.aspect_ratio;
+    camera.image_width = static_cast<uint32_t>(header.image_width_high) << 16 | header.image_width;
+    camera.samples_per_pixel = header.samples_per_pixel;
+    camera.max_depth = header.max_depth;
+    camera.vfov = header.vfov;
+    camera.look_from = Point3(header.look_from[0], header.look_from[1], header.look_from[2]);
+    camera.look_at = Point3(header.look_at[0], header.look_at[1], header.look_at[2]);
+    camera.vector_up = Vec3(header.vector_up[0], header.vector_up[1], header.vector_up[2]);
+    camera.defocus_angle = header.defocus_angle;
+    camera.focus_dist = header.focus_dist;
+    if(!valid_camera(camera, error)){
+        error = "camera: " + error;
+        return false;
+    }
+
+    // Materials are constructed, as they carry a vtable
+    for(uint64_t i = 0;i < header.material_count;i++){
+        MaterialRecord record;
+        std::memcpy(&record, file->data() + layout.materials + i * sizeof(record), sizeof(record));
+        if(!valid_material(record, error)){
+            error = "material " + std::to_string(i) + ": " + error;
+            return false;
+        }
+        scene.materials.add(record);
+    }
+
+    const uint64_t count = header.sphere_count;
+    const auto column = [&](const uint64_t offset){
+        return Column<double>::view(reinterpret_cast<const double*>(file->data() + offset), count);
+    };
+    const Column<uint32_t> materials = Column<uint32_t>::view(
+        reinterpret_cast<const uint32_t*>(file->data() + layout.sphere_materials), count);
+    const Column<double> center_x = column(layout.center_x), center_y = column(layout.center_y);
+    const Column<double> center_z = column(layout.center_z), radius = column(layout.radius);
+    for(uint64_t i = 0;i < count;i++){
+        if(materials[i] >= header.material_count){
+            error = "sphere " + std::to_string(i) + " refers to a missing material";
+            return false;
+        }
+        if(!valid_sphere(Point3(center_x[i], center_y[i], center_z[i]), radius[i], error)){
+            error = "sphere " + std::to_string(i) + ": " + error;
+            return false;
+        }
+    }
+    scene.spheres.geometry.center_x = center_x;
+    scene.spheres.geometry.center_y = center_y;
+    scene.spheres.geometry.center_z = center_z;
+    scene.spheres.geometry.radius = radius;
+    scene.spheres.materials = materials;
+    scene.mapping = file;
+    return true;
+}
+
+/// @brief Loads a scene file in either form, error describes the problem if it fails.
+inline bool load_scene(const std::string& path, Scene& scene, std::string& error) {
+    const std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if(!file->open(path)){
+        error = "can't open " + path;
+        return false;
+    }
+    if(file->size() >= sizeof(SceneFileHeader::signature) && std::memcmp(
+        file->data(), SceneFileHeader::signature, sizeof(SceneFileHeader::signature)) == 0){
+        return load_scene_binary(file, scene, error);
+    }
+    std::istringstream text(std::string(reinterpret_cast<const char*>(file->data()), file->size()));
+    return load_scene_text(text, scene, error);
+}
+
+/// @brief Writes the scene in text form, naming material i "m<i>".
+inline void save_scene_text(const Scene& scene, std::ostream& out) {
+    const CameraParameters& camera = scene.camera;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << "aspect_ratio " << camera.aspect_ratio << "\nimage_width " << camera.image_width
+        << "\nsamples_per_pixel " << camera.samples_per_pixel
+        << "\nmax_depth " << static_cast<unsigned>(camera.max_depth) << "\nvfov " << camera.vfov
+        << "\nlook_from " << camera.look_from << "\nlook_at " << camera.look_at
+        << "\nvector_up " << camera.vector_up << "\ndefocus_angle " << camera.defocus_angle
+        << "\nfocus_dist " << camera.focus_dist << "\n\n";
+
+    static const char* const kind_names[] = {"lambertian", "metal", "dielectric"};
+    static const uint8_t parameter_counts[] = {3, 4, 1};
+    for(uint32_t i = 0;i < scene.materials.size();i++){
+        const MaterialRecord record = scene.materials[i].record();
+        const uint8_t kind = static_cast<uint8_t>(record.kind);
+        out << kind_names[kind] << " m" << i;
+        for(uint8_t parameter = 0;parameter < parameter_counts[kind];parameter++){
+            out << ' ' << record.parameters[parameter];
+        }
+        out << '\n';
+    }
+    out << '\n';
+
+    const SphereArrays& geometry = scene.spheres.geometry;
+    for(size_t i = 0;i < scene.spheres.size();i++){
+        out << "sphere " << geometry.center(i) << ' ' << geometry.radius[i] << " m"
+            << scene.spheres.materials[i] << '\n';
+    }
+    for(const MeshPlacement& placement : scene.mesh_placements){
+        out << "mesh " << placement.path << " m" << placement.material << ' ' << placement.position << ' '
+            << placement.scale << '\n';
+    }
+}
+
+/// @brief Writes the scene in binary form, which has no room for meshes and instances.
+/// Fails without writing anything for scenes that have some, error says why.
+inline bool save_scene_binary(const Scene& scene, std::ostream& out, std::string& error) {
+    if(!scene.meshes.empty() || !scene.instances.empty()){
+        error = "the binary form can't hold meshes and instances, save the scene in text form (.txt)";
+        return false;
+    }
+    const CameraParameters& camera = scene.camera;
+    SceneFileHeader header{};
+    std::memcpy(header.magic, SceneFileHeader::signature, sizeof(header.magic));
+    header.version = SceneFileHeader::current_version;
+    header.byte_order = SceneFileHeader::native_byte_order;
+    header.material_count = scene.materials.size();
+    header.sphere_count = scene.spheres.size();
+    header.aspect_ratio = camera.aspect_ratio;
+    header.vfov = camera.vfov;
+    header.defocus_angle = camera.defocus_angle;
+    header.focus_dist = camera.focus_dist;
+    for(uint8_t axis = 0;axis < 3;axis++){
+        header.look_from[axis] = camera.look_from[axis];
+        header.look_at[axis] = camera.look_at[axis];
+        header.vector_up[axis] = camera.vector_up[axis];
+    }
+    header.image_width = static_cast<uint16_t>(camera.image_width);
+    header.image_width_high = static_cast<uint16_t>(camera.image_width >> 16);
+    header.samples_per_pixel = camera.samples_per_pixel;
+    header.max_depth = camera.max_depth;
+    const SceneFileLayout layout(header);
+
+    uint64_t position = 0;
+    const auto write = [&](const uint64_t offset, const void* const data, const uint64_t size){
+        static const char padding[SceneFileLayout::alignment] = {};
+        out.write(padding, static_cast<std::streamsize>(offset - position));
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        position = offset + size;
+    };
+    write(0, &header, sizeof(header));
+    for(uint32_t i = 0;i < scene.materials.size();i++){
+        const MaterialRecord record = scene.materials[i].record();
+        write(layout.materials + i * sizeof(record), &record, sizeof(record));
+    }
+    const SphereArrays& geometry = scene.spheres.geometry;
+    const uint64_t column_bytes = header.sphere_count * sizeof(double);
+    write(layout.center_x, geometry.center_x.data(), column_bytes);
+    write(layout.center_y, geometry.center_y.data(), column_bytes);
+    write(layout.center_z, geometry.center_z.data(), column_bytes);
+    write(layout.radius, geometry.radius.data(), column_bytes);
+    write(layout.sphere_materials, scene.spheres.materials.data(), header.sphere_count * sizeof(uint32_t));
+    return true;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+
+#include "Framebuffer.hpp"
+#include "RenderSettings.hpp"
+
+// A shard is the part of a frame one render produced: a ShardHeader followed by the ColorSum
+// and the sample count of every pixel of the frame, zero for the pixels it didn't sample.
+// Merging the shards of all parts of a frame gives the same bits as rendering it at once.
+// Checkpoints are shards as well. A pixel with n samples holds samples [sample_begin,
+// sample_begin + n) of the pixel, as the sampler of every sample only depends on the seed,
+// frame, pixel, sample index and sample pattern, that is all it takes to continue sampling it.
+
+/// @brief Header of a shard file, in the byte order of the machine that wrote it.
+struct ShardHeader{
+    static constexpr char signature[8] = {'R', 'T', 'S', 'H', 'A', 'R', 'D', '\0'};
+    static constexpr uint32_t current_version = 2;
+    static constexpr uint32_t native_byte_order = 0x01020304;
+
+    char magic[8]{};
+    uint32_t version = 0;
+    uint32_t byte_order = 0;
+    uint64_t seed = 0;               // Seed of the render, shards of one frame must share it
+    uint32_t frame = 0;              // Frame number of the render
+    uint32_t width = 0, height = 0;  // Size of the frame
+    uint16_t samples_per_pixel = 0;  // Samples per pixel of the whole frame
+    uint16_t sample_begin = 0;       // First sample index of every pixel in the shard
+    uint16_t sample_pattern = 0;     // SamplePattern of the render
+    uint16_t sample_end = 0;         // End of the sample indices of every pixel in the shard
+    uint16_t reserved[2]{};
+
+    inline ShardHeader() noexcept = default;
+
+    inline ShardHeader(const Framebuffer& image, const RenderSettings& settings, const uint16_t samples) noexcept
+        : version(current_version), byte_order(native_byte_order), seed(settings.seed), frame(settings.frame),
+        width(image.width), height(image.height), samples_per_pixel(samples),
+        sample_begin(std::min(settings.sample_begin, samples)),
+        sample_pattern(static_cast<uint16_t>(settings.sample_pattern)),
+        sample_end(std::min(settings.sample_end, samples)) {
+        std::memcpy(magic, signature, sizeof(magic));
+    }
+
+    /// @brief Returns whether both shards are parts of the same frame.
+    inline bool same_frame(const ShardHeader& other) const noexcept {
+        return seed == other.seed && frame == other.frame && width == other.width &&
+            height == other.height && samples_per_pixel == other.samples_per_pixel &&
+            sample_pattern == other.sample_pattern;
+    }
+
+    /// @brief Returns whether both shards of a frame may hold the same sample of a pixel,
+    /// so they must not both have samples for any pixel.
+    inline bool sample_ranges_overlap(const ShardHeader& other) const noexcept {
+        if(sample_begin >= sample_end || other.sample_begin >= other.sample_end){
+            return false; // An empty range holds no samples
+        }
+        return sample_begin < other.sample_end && other.sample_begin < sample_end;
+    }
+};
+
+static_assert(std::is_trivially_copyable<ShardHeader>::value && sizeof(ShardHeader) == 48,
+    "ShardHeader is written and read as its bytes");
+
+inline void save_shard(const Framebuffer& image, const ShardHeader& header, std::ostream& out) {
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(image.sums.data()),
+        static_cast<std::streamsize>(image.sums.size() * sizeof(ColorSum)));
+    out.write(reinterpret_cast<const char*>(image.sample_counts.data()),
+        static_cast<std::streamsize>(image.sample_counts.size() * sizeof(uint16_t)));
+}
+
+/// @brief Reads a shard into `image`, error describes the problem if it fails.
+inline bool load_shard(std::istream& in, Framebuffer& image, ShardHeader& header, std::string& error) {
+    // Read in one piece, the way save_shard writes it
+    if(!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, ShardHeader::signature, sizeof(header.magic)) != 0 ||
+        header.version != ShardHeader::current_version){
+        error = "not a shard of version " + std::to_string(ShardHeader::current_version);
+        return false;
+    }
+    if(header.byte_order != ShardHeader::native_byte_order){
+        error = "written on a machine of another byte order";
+        return false;
+    }
+    if(header.sample_pattern > static_cast<uint16_t>(SamplePattern::BlueNoise)){
+        error = "unknown sample pattern " + std::to_string(header.sample_pattern);
+        return false;
+    }
+    if(header.sample_begin > header.sample_end || header.sample_end > header.samples_per_pixel){
+        error = "invalid sample range " + std::to_string(header.sample_begin) + ":"
+            + std::to_string(header.sample_end) + " of " + std::to_string(header.samples_per_pixel) + " samples";
+        return false;
+    }
+    // A corrupt size must not allocate a frame larger than the data the stream holds
+    const std::istream::pos_type data_begin = in.tellg();
+    if(data_begin != std::istream::pos_type(-1) && in.seekg(0, std::ios::end)){
+        const uint64_t data_size = static_cast<uint64_t>(in.tellg() - data_begin);
+        in.seekg(data_begin);
+        if(static_cast<uint64_t>(header.width) * header.height > data_size / (sizeof(ColorSum) + sizeof(uint16_t))){
+            error = "truncated shard, " + std::to_string(header.width) + "x" + std::to_string(header.height)
+                + " pixels don't fit into the " + std::to_string(data_size) + " bytes after the header";
+            return false;
+        }
+    }
+    image = Framebuffer(header.width, header.height);
+    in.read(reinterpret_cast<char*>(image.sums.data()),
+        static_cast<std::streamsize>(image.sums.size() * sizeof(ColorSum)));
+    in.read(reinterpret_cast<char*>(image.sample_counts.data()),
+        static_cast<std::streamsize>(image.sample_counts.size() * sizeof(uint16_t)));
+    if(!in){
+        error = "truncated shard";
+        return false;
+    }
+    for(size_t i = 0;i < image.pixels.size();i++){
+        image.pixels[i] = image.sums[i].mean(image.sample_counts[i]);
+    }
+    return true;
+}
+
+/// @brief Writes a shard to a file. The shard is written to a temporary file that then
+/// replaces the file, so the file always holds a complete shard, even if writing is interrupted.
+inline bool save_shard_file(const std::string& path, const Framebuffer& image, const ShardHeader& header) {
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream out(temporary_path, std::ios::binary);
+        save_shard(image, header, out);
+        if(!out.flush()){
+            return false;
+        }
+    }
+    return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
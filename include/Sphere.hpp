@@ -1,51 +1,91 @@
 #pragma once
 
-#include <memory>
+#include <cstdint>
 
+#include "Column.hpp"
 #include "Hittable.hpp"
+#include "RenderStats.hpp"
+#include "SpherePacket.hpp"
 #include "Vec3.hpp"
 
-class Sphere : public Hittable {
-private:
-    const Point3 center;
-    const double radius;
-    const std::shared_ptr<Material> material;
-public:
-    inline Sphere(const Point3 center_point, const double rad, const std::shared_ptr<Material> mat)
-        : center(center_point), radius(std::fmax(0, rad)), material(mat) {}
+/// @brief Contiguous storage for the spheres of a scene: geometry in structure-of-arrays
+/// layout and the index of every sphere's material in the scene's MaterialTable.
+struct SphereStorage{
+    SphereArrays geometry;
+    Column<uint32_t> materials;
 
-    inline bool hit(const Ray& ray, const Interval ray_time, HitRecord& record) const override {
-        const Vec3 origin_center = center - ray.origin();
-        const double a = ray.direction().length_squared();
-        const double h = ray.direction().dot(origin_center);
-        const double c = origin_center.length_squared() - radius * radius;
+    inline uint32_t add(const Point3 center, const double radius, const uint32_t material) {
+        geometry.push_back(center, radius);
+        materials.push_back(material);
+        return static_cast<uint32_t>(materials.size() - 1);
+    }
 
-        const double discriminant = h * h - a * c;
-        if(discriminant < 0){
-            return false;
-        }
+    inline size_t size() const noexcept {
+        return materials.size();
+    }
+
+    inline void reserve(const size_t count) {
+        geometry.center_x.reserve(count);
+        geometry.center_y.reserve(count);
+        geometry.center_z.reserve(count);
+        geometry.radius.reserve(count);
+        materials.reserve(count);
+    }
 
-        const double sqrt_discriminant = std::sqrt(discriminant);
+    /// @brief Moves sphere `index` to a new center.
+    inline void move(const uint32_t index, const Point3& center) {
+        geometry.center_x[index] = center.x();
+        geometry.center_y[index] = center.y();
+        geometry.center_z[index] = center.z();
+    }
 
-        // Find the nearest root that lies in the acceptable range.
-        double root = (h - sqrt_discriminant) / a;
-        if(!ray_time.surrounds(root)){
-            root = (h + sqrt_discriminant) / a;
-            if(!ray_time.surrounds(root)){
-                return false;
-            }
+    inline AABB bounding_box(const uint32_t index) const noexcept {
+        const double radius = geometry.radius[index];
+        const Vec3 extent(radius, radius, radius);
+        return AABB(geometry.center(index) - extent, geometry.center(index) + extent);
+    }
+
+    /// @brief Fills the hit record for a ray known to hit sphere `index` at the given time.
+    inline void fill_record(const Ray& ray, const uint32_t index, const double time,
+        HitRecord& record) const noexcept {
+        record.point = ray.at(time);
+        record.time = time;
+        record.material = materials[index];
+        record.set_face_normal(ray, (record.point - geometry.center(index)) / geometry.radius[index]);
+    }
+
+    /// @brief Finds the nearest hit among the spheres in [begin, end).
+    inline bool hit(const Ray& ray, const Interval ray_time, const size_t begin, const size_t end,
+        HitRecord& record) const {
+        const SphereHit nearest = nearest_sphere_hit(geometry, ray, ray_time, begin, end);
+        if(nearest.index == SphereHit::no_hit){
+            return false;
         }
+        fill_record(ray, nearest.index, nearest.time, record);
+        return true;
+    }
+};
 
-        const Point3 point = ray.at(root);
-        record = HitRecord{
-            .point = point,
-            .normal = (point - center) / radius,
-            .time = root,
-            .material = material
-        };
-        const Vec3 outward_normal = (record.point - center) / radius;
-        record.set_face_normal(ray, outward_normal);
+/// @brief View of a single sphere in a SphereStorage.
+class Sphere : public Hittable {
+private:
+    const SphereStorage& storage;
+    const uint32_t index;
+public:
+    inline Sphere(const SphereStorage& sphere_storage, const uint32_t sphere_index) noexcept
+        : storage(sphere_storage), index(sphere_index) {}
 
+    inline bool hit(const Ray& ray, const Interval ray_time, HitRecord& record) const override {
+        RAY_TRACER_STAT(thread_stats().primitive_tests++);
+        const SphereHit nearest = nearest_sphere_hit_scalar(storage.geometry, ray, ray_time, index, index + 1);
+        if(nearest.index == SphereHit::no_hit){
+            return false;
+        }
+        storage.fill_record(ray, index, nearest.time, record);
         return true;
     }
+
+    inline AABB bounding_box() const override {
+        return storage.bounding_box(index);
+    }
 };
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RAY_TRACER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#include "Column.hpp"
+#include "Ray.hpp"
+#include "Interval.hpp"
+#include "RenderStats.hpp"
+
+/// @brief Sphere geometry in structure-of-arrays layout, so that consecutive spheres fill
+/// the lanes of a vector register. The arrays can view a memory-mapped scene file in place.
+struct SphereArrays{
+    Column<double> center_x, center_y, center_z, radius;
+
+    inline size_t size() const noexcept {
+        return radius.size();
+    }
+
+    inline void push_back(const Point3& center, const double rad) {
+        center_x.push_back(center.x());
+        center_y.push_back(center.y());
+        center_z.push_back(center.z());
+        radius.push_back(std::fmax(0, rad));
+    }
+
+    inline Point3 center(const size_t index) const noexcept {
+        return Point3(center_x[index], center_y[index], center_z[index]);
+    }
+};
+
+/// @brief Nearest sphere a ray hits, `index` is `no_hit` when it misses all of them.
+struct SphereHit{
+    static constexpr uint32_t no_hit = UINT32_MAX;
+
+    uint32_t index = no_hit;
+    double time = INFINITY;
+};
+
+/// Instruction sets the packet kernels are available for.
+enum class SimdLevel : uint8_t { Scalar, AVX2, AVX512 };
+
+/// Signature of a kernel returning the nearest hit among the spheres in [begin, end).
+using NearestSphereKernel = SphereHit(*)(
+    const SphereArrays& spheres, const Ray& ray, Interval ray_time, size_t begin, size_t end);
+
+/// @brief Tests the ray against the spheres in [begin, end) one at a time.
+/// Performs the same operations in the same order as Sphere::hit, so that all kernels agree.
+/// On equal distances the sphere with the lowest index wins, like in a sequential scan.
+inline SphereHit nearest_sphere_hit_scalar(
+    const SphereArrays& spheres, const Ray& ray, const Interval ray_time, const size_t begin,
+    const size_t end) {
+    const Vec3& direction = ray.direction();
+    const double a = direction.length_squared();
+
+    SphereHit nearest;
+    for(size_t i = begin;i < end;i++){
+        const double ocx = spheres.center_x[i] - ray.origin().x();
+        const double ocy = spheres.center_y[i] - ray.origin().y();
+        const double ocz = spheres.center_z[i] - ray.origin().z();
+        const double h = direction.x() * ocx + direction.y() * ocy + direction.z() * ocz;
+        const double c = (ocx * ocx + ocy * ocy + ocz * ocz) - spheres.radius[i] * spheres.radius[i];
+
+        const double discriminant = h * h - a * c;
+        if(discriminant < 0){
+            continue;
+        }
+        const double sqrt_discriminant = std::sqrt(discriminant);
+        const double near_root = (h - sqrt_discriminant) / a;
+        const double far_root = (h + sqrt_discriminant) / a;
+        const double root = ray_time.surrounds(near_root)? near_root : far_root;
+        if(ray_time.surrounds(root) && root < nearest.time){
+            nearest.index = static_cast<uint32_t>(i);
+            nearest.time = root;
+        }
+    }
+    return nearest;
+}
+
+#ifdef RAY_TRACER_X86_SIMD
+/// @brief Tests the ray against four spheres per iteration using AVX2.
+__attribute__((target("avx2")))
+inline SphereHit nearest_sphere_hit_avx2(
+    const SphereArrays& spheres, const Ray& ray, const Interval ray_time, const size_t begin,
+    const size_t end) {
+    constexpr size_t lanes = 4;
+    const __m256d origin_x = _mm256_set1_pd(ray.origin().x());
+    const __m256d origin_y = _mm256_set1_pd(ray.origin().y());
+    const __m256d origin_z = _mm256_set1_pd(ray.origin().z());
+    const __m256d direction_x = _mm256_set1_pd(ray.direction().x());
+    const __m256d direction_y = _mm256_set1_pd(ray.direction().y());
+    const __m256d direction_z = _mm256_set1_pd(ray.direction().z());
+    const __m256d a = _mm256_set1_pd(ray.direction().length_squared());
+    const __m256d time_min = _mm256_set1_pd(ray_time.min);
+    const __m256d time_max = _mm256_set1_pd(ray_time.max);
+    const __m256d zero = _mm256_setzero_pd();
+
+    __m256d best_time = _mm256_set1_pd(INFINITY);
+    __m256d best_index = _mm256_set1_pd(-1);
+    __m256d index = _mm256_setr_pd(begin, begin + 1, begin + 2, begin + 3);
+    const __m256d index_step = _mm256_set1_pd(lanes);
+
+    size_t i = begin;
+    for(;i + lanes <= end;i += lanes){
+        const __m256d ocx = _mm256_sub_pd(_mm256_loadu_pd(&spheres.center_x[i]), origin_x);
+        const __m256d ocy = _mm256_sub_pd(_mm256_loadu_pd(&spheres.center_y[i]), origin_y);
+        const __m256d ocz = _mm256_sub_pd(_mm256_loadu_pd(&spheres.center_z[i]), origin_z);
+        const __m256d radius = _mm256_loadu_pd(&spheres.radius[i]);
+
+        const __m256d h = _mm256_add_pd(_mm256_add_pd(
+            _mm256_mul_pd(direction_x, ocx), _mm256_mul_pd(direction_y, ocy)),
+            _mm256_mul_pd(direction_z, ocz));
+        const __m256d c = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(
+            _mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz)),
+            _mm256_mul_pd(radius, radius));
+        const __m256d discriminant = _mm256_sub_pd(_mm256_mul_pd(h, h), _mm256_mul_pd(a, c));
+        const __m256d real = _mm256_cmp_pd(discriminant, zero, _CMP_GE_OQ);
+
+        const __m256d sqrt_discriminant = _mm256_sqrt_pd(_mm256_max_pd(discriminant, zero));
+        const __m256d near_root = _mm256_div_pd(_mm256_sub_pd(h, sqrt_discriminant), a);
+        const __m256d far_root = _mm256_div_pd(_mm256_add_pd(h, sqrt_discriminant), a);
+        const __m256d near_inside = _mm256_and_pd(_mm256_cmp_pd(near_root, time_min, _CMP_GT_OQ),
+            _mm256_cmp_pd(near_root, time_max, _CMP_LT_OQ));
+        const __m256d root = _mm256_blendv_pd(far_root, near_root, near_inside);
+        const __m256d accepted = _mm256_and_pd(_mm256_and_pd(real,
+            _mm256_cmp_pd(root, time_min, _CMP_GT_OQ)), _mm256_and_pd(
+            _mm256_cmp_pd(root, time_max, _CMP_LT_OQ), _mm256_cmp_pd(root, best_time, _CMP_LT_OQ)));
+
+        best_time = _mm256_blendv_pd(best_time, root, accepted);
+        best_index = _mm256_blendv_pd(best_index, index, accepted);
+        index = _mm256_add_pd(index, index_step);
+    }
+
+    // Reduce the lanes, the lowest index wins on equal distances
+    alignas(32) double times[lanes], indices[lanes];
+    _mm256_store_pd(times, best_time);
+    _mm256_store_pd(indices, best_index);
+    SphereHit nearest = nearest_sphere_hit_scalar(spheres, ray, ray_time, i, end);
+    for(size_t lane = 0;lane < lanes;lane++){
+        if(indices[lane] >= 0 && (times[lane] < nearest.time ||
+            (times[lane] == nearest.time && indices[lane] < nearest.index))){
+            nearest.index = static_cast<uint32_t>(indices[lane]);
+            nearest.time = times[lane];
+        }
+    }
+    return nearest;
+}
+
+/// @brief Tests the ray against eight spheres per iteration using AVX-512.
+__attribute__((target("avx512f")))
+inline SphereHit nearest_sphere_hit_avx512(
+    const SphereArrays& spheres, const Ray& ray, const Interval ray_time, const size_t begin,
+    const size_t end) {
+    constexpr size_t lanes = 8;
+    const __m512d origin_x = _mm512_set1_pd(ray.origin().x());
+    const __m512d origin_y = _mm512_set1_pd(ray.origin().y());
+    const __m512d origin_z = _mm512_set1_pd(ray.origin().z());
+    const __m512d direction_x = _mm512_set1_pd(ray.direction().x());
+    const __m512d direction_y = _mm512_set1_pd(ray.direction().y());
+    const __m512d direction_z = _mm512_set1_pd(ray.direction().z());
+    const __m512d a = _mm512_set1_pd(ray.direction().length_squared());
+    const __m512d time_min = _mm512_set1_pd(ray_time.min);
+    const __m512d time_max = _mm512_set1_pd(ray_time.max);
+    const __m512d zero = _mm512_setzero_pd();
+
+    __m512d best_time = _mm512_set1_pd(INFINITY);
+    __m512d best_index = _mm512_set1_pd(-1);
+    __m512d index = _mm512_setr_pd(
+        begin, begin + 1, begin + 2, begin + 3, begin + 4, begin + 5, begin + 6, begin + 7);
+    const __m512d index_step = _mm512_set1_pd(lanes);
+
+    size_t i = begin;
+    for(;i + lanes <= end;i += lanes){
+        const __m512d ocx = _mm512_sub_pd(_mm512_loadu_pd(&spheres.center_x[i]), origin_x);
+        const __m512d ocy = _mm512_sub_pd(_mm512_loadu_pd(&spheres.center_y[i]), origin_y);
+        const __m512d ocz = _mm512_sub_pd(_mm512_loadu_pd(&spheres.center_z[i]), origin_z);
+        const __m512d radius = _mm512_loadu_pd(&spheres.radius[i]);
+
+        const __m512d h = _mm512_add_pd(_mm512_add_pd(
+            _mm512_mul_pd(direction_x, ocx), _mm512_mul_pd(direction_y, ocy)),
+            _mm512_mul_pd(direction_z, ocz));
+        const __m512d c = _mm512_sub_pd(_mm512_add_pd(_mm512_add_pd(
+            _mm512_mul_pd(ocx, ocx), _mm512_mul_pd(ocy, ocy)), _mm512_mul_pd(ocz, ocz)),
+            _mm512_mul_pd(radius, radius));
+        const __m512d discriminant = _mm512_sub_pd(_mm512_mul_pd(h, h), _mm512_mul_pd(a, c));
+        const __mmask8 real = _mm512_cmp_pd_mask(discriminant, zero, _CMP_GE_OQ);
+
+        const __m512d sqrt_discriminant = _mm512_sqrt_pd(_mm512_max_pd(discriminant, zero));
+        const __m512d near_root = _mm512_div_pd(_mm512_sub_pd(h, sqrt_discriminant), a);
+        const __m512d far_root = _mm512_div_pd(_mm512_add_pd(h, sqrt_discriminant), a);
+        const __mmask8 near_inside = _mm512_cmp_pd_mask(near_root, time_min, _CMP_GT_OQ)
+            & _mm512_cmp_pd_mask(near_root, time_max, _CMP_LT_OQ);
+        const __m512d root = _mm512_mask_blend_pd(near_inside, far_root, near_root);
+        const __mmask8 accepted = real & _mm512_cmp_pd_mask(root, time_min, _CMP_GT_OQ)
+            & _mm512_cmp_pd_mask(root, time_max, _CMP_LT_OQ)
+            & _mm512_cmp_pd_mask(root, best_time, _CMP_LT_OQ);
+
+        best_time = _mm512_mask_blend_pd(accepted, best_time, root);
+        best_index = _mm512_mask_blend_pd(accepted, best_index, index);
+        index = _mm512_add_pd(index, index_step);
+    }
+
+    // Reduce the lanes, the lowest index wins on equal distances
+    alignas(64) double times[lanes], indices[lanes];
+    _mm512_store_pd(times, best_time);
+    _mm512_store_pd(indices, best_index);
+    SphereHit nearest = nearest_sphere_hit_scalar(spheres, ray, ray_time, i, end);
+    for(size_t lane = 0;lane < lanes;lane++){
+        if(indices[lane] >= 0 && (times[lane] < nearest.time ||
+            (times[lane] == nearest.time && indices[lane] < nearest.index))){
+            nearest.index = static_cast<uint32_t>(indices[lane]);
+            nearest.time = times[lane];
+        }
+    }
+    return nearest;
+}
+#endif
+
+/// @brief Returns the widest instruction set the processor running the program supports.
+/// The environment variable RAY_TRACER_SIMD (scalar, avx2 or avx512) lowers the selection.
+inline SimdLevel detect_simd_level() noexcept {
+    SimdLevel level = SimdLevel::Scalar;
+#ifdef RAY_TRACER_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")){
+        level = SimdLevel::AVX512;
+    }else if(__builtin_cpu_supports("avx2")){
+        level = SimdLevel::AVX2;
+    }
+#endif
+    const char* const requested = std::getenv("RAY_TRACER_SIMD");
+    if(requested != nullptr){
+        const std::string_view name = requested;
+        if(name == "scalar"){
+            level = SimdLevel::Scalar;
+        }else if(name == "avx2" && level != SimdLevel::Scalar){
+            level = SimdLevel::AVX2;
+        }
+    }
+    return level;
+}
+
+/// @brief Returns the kernel for an instruction set, the caller must check it is supported.
+inline NearestSphereKernel nearest_sphere_kernel(const SimdLevel level) noexcept {
+    switch(level){
+#ifdef RAY_TRACER_X86_SIMD
+        case SimdLevel::AVX512: return nearest_sphere_hit_avx512;
+        case SimdLevel::AVX2: return nearest_sphere_hit_avx2;
+#endif
+        default: return nearest_sphere_hit_scalar;
+    }
+}
+
+/// @brief Returns the nearest hit among the spheres in [begin, end), using the widest kernel
+/// the processor supports. The kernel is selected once, on the first call.
+inline SphereHit nearest_sphere_hit(
+    const SphereArrays& spheres, const Ray& ray, const Interval ray_time, const size_t begin,
+    const size_t end) {
+    static const NearestSphereKernel kernel = nearest_sphere_kernel(detect_simd_level());
+    RAY_TRACER_STAT(thread_stats().primitive_tests += end - begin);
+    return kernel(spheres, ray, ray_time, begin, end);
+}
+
+/// @brief Returns the nearest hit among at most four spheres in [begin, end), like the spheres
+/// of a BVH leaf. Only a full AVX2 packet is worth its setup, AVX-512 lanes would stay empty.
+inline SphereHit nearest_sphere_hit_leaf(
+    const SphereArrays& spheres, const Ray& ray, const Interval ray_time, const size_t begin,
+    const size_t end) {
+    static const bool packets = detect_simd_level() != SimdLevel::Scalar;
+    RAY_TRACER_STAT(thread_stats().primitive_tests += end - begin);
+#ifdef RAY_TRACER_X86_SIMD
+    if(packets && end - begin == 4){
+        return nearest_sphere_hit_avx2(spheres, ray, ray_time, begin, end);
+    }
+#endif
+    return nearest_sphere_hit_scalar(spheres, ray, ray_time, begin, end);
+}
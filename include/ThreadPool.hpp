@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief A fixed set of worker threads that execute batches of indexed tasks.
+/// Every worker owns a queue of task indices. A worker takes tasks from the front of its own
+/// queue and, once it runs dry, steals from the back of the queues of the other workers.
+class ThreadPool{
+public:
+    /// Signature of a task, called with the task index and the index of the executing worker.
+    using Task = std::function<void(size_t task, size_t worker)>;
+private:
+    struct WorkQueue{
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;                      // Guards the batch state below
+    std::condition_variable batch_started; // Signals the workers that a batch is available
+    std::condition_variable batch_done;    // Signals the caller that all workers are idle
+    const Task* task = nullptr;            // Task of the current batch
+    uint64_t batch = 0;                    // Number of the current batch
+    size_t busy_workers = 0;               // Workers still working on the current batch
+    bool stopping = false;
+
+    /// @brief Takes a task from the own queue, or steals one from another worker.
+    inline bool next_task(const size_t worker, size_t& index) {
+        {
+            WorkQueue& own = *queues[worker];
+            const std::lock_guard<std::mutex> lock(own.mutex);
+            if(!own.tasks.empty()){
+                index = own.tasks.front();
+                own.tasks.pop_front();
+                return true;
+            }
+        }
+        for(size_t offset = 1;offset < queues.size();offset++){
+            WorkQueue& victim = *queues[(worker + offset) % queues.size()];
+            const std::lock_guard<std::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty()){
+                index = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void work(const size_t worker) {
+        uint64_t finished_batch = 0;
+        while(true){
+            const Task* current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                batch_started.wait(lock, [&]{ return stopping || batch != finished_batch; });
+                if(stopping){
+                    return;
+                }
+                finished_batch = batch;
+                current = task;
+            }
+
+            size_t index;
+            while(next_task(worker, index)){
+                (*current)(index, worker);
+            }
+
+            const std::lock_guard<std::mutex> lock(mutex);
+            if(--busy_workers == 0){
+                batch_done.notify_one();
+            }
+        }
+    }
+public:
+    /// @brief Starts the given number of workers, 0 selects one worker per hardware thread.
+    inline explicit ThreadPool(size_t thread_count = 0) {
+        if(thread_count == 0){
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for(size_t i = 0;i < thread_count;i++){
+            queues.push_back(std::make_unique<WorkQueue>());
+        }
+        for(size_t i = 0;i < thread_count;i++){
+            workers.emplace_back(&ThreadPool::work, this, i);
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    inline ~ThreadPool() noexcept {
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        batch_started.notify_all();
+        for(std::thread& worker : workers){
+            worker.join();
+        }
+    }
+
+    inline size_t size() const noexcept {
+        return workers.size();
+    }
+
+    /// @brief Runs the task for every index in [0, task_count) and waits until all are done.
+    /// Consecutive indices are dealt to the same worker, so neighbouring tiles share caches.
+    inline void run(const size_t task_count, const Task& batch_task) {
+        if(task_count == 0){
+            return;
+        }
+        const size_t per_worker = (task_count + queues.size() - 1) / queues.size();
+        for(size_t i = 0;i < task_count;i++){
+            WorkQueue& queue = *queues[i / per_worker];
+            const std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(i);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        task = &batch_task;
+        busy_workers = workers.size();
+        batch++;
+        batch_started.notify_all();
+        batch_done.wait(lock, [&]{ return busy_workers == 0; });
+        task = nullptr;
+    }
+};
+
+/// @brief The pool of shared_thread_pool, used by one thread at a time: other threads asking
+/// for it wait until this is destroyed.
+class SharedThreadPool{
+private:
+    std::unique_lock<std::mutex> lock;
+    ThreadPool& pool;
+public:
+    inline SharedThreadPool(std::unique_lock<std::mutex>&& pool_lock, ThreadPool& shared_pool) noexcept
+        : lock(std::move(pool_lock)), pool(shared_pool) {}
+
+    inline ThreadPool& operator*() const noexcept {
+        return pool;
+    }
+
+    inline ThreadPool* operator->() const noexcept {
+        return &pool;
+    }
+};
+
+/// @brief Returns a pool with the given number of workers, 0 selecting one per hardware
+/// thread, that lives until the program ends. Frame after frame, the renders run on the same
+/// threads, so what the workers keep in thread_local storage, like their scratch arenas, is
+/// allocated once. Renders on several threads take turns: the pool is locked for the caller
+/// until the returned SharedThreadPool is destroyed, so it must not ask for it again before.
+inline SharedThreadPool shared_thread_pool(const size_t thread_count = 0) {
+    static std::mutex mutex;
+    static std::unique_ptr<ThreadPool> pool;
+    static size_t requested_count = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    if(!pool || requested_count != thread_count){
+        pool.reset();
+        pool = std::make_unique<ThreadPool>(thread_count);
+        requested_count = thread_count;
+    }
+    return SharedThreadPool(std::move(lock), *pool);
+}
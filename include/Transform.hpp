@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cmath>
+
+#include "AABB.hpp"
+#include "util.hpp"
+
+/// @brief Affine transform, stored as the rows of a 3x4 matrix: the linear part in the first
+/// three columns and the translation in the last. Transforms compose right to left, like
+/// matrices: `(a * b).point(p) == a.point(b.point(p))`.
+struct Transform{
+    double m[3][4];
+
+    static inline constexpr Transform identity() noexcept {
+        return Transform{{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}}};
+    }
+
+    static inline constexpr Transform translation(const Vec3& offset) noexcept {
+        return Transform{{{1, 0, 0, offset.x()}, {0, 1, 0, offset.y()}, {0, 0, 1, offset.z()}}};
+    }
+
+    static inline constexpr Transform scaling(const Vec3& factors) noexcept {
+        return Transform{{{factors.x(), 0, 0, 0}, {0, factors.y(), 0, 0}, {0, 0, factors.z(), 0}}};
+    }
+
+    static inline constexpr Transform scaling(const double factor) noexcept {
+        return scaling(Vec3(factor, factor, factor));
+    }
+
+    /// @brief Returns a counterclockwise rotation around the axis, given in degrees.
+    static inline Transform rotation(const Vec3& axis, const double degrees) noexcept {
+        const Vec3 a = axis.unit_vector();
+        const double sine = std::sin(degrees_to_radians(degrees));
+        const double cosine = std::cos(degrees_to_radians(degrees));
+        const double c = 1 - cosine;
+        return Transform{{
+            {cosine + a.x() * a.x() * c, a.x() * a.y() * c - a.z() * sine, a.x() * a.z() * c + a.y() * sine, 0},
+            {a.y() * a.x() * c + a.z() * sine, cosine + a.y() * a.y() * c, a.y() * a.z() * c - a.x() * sine, 0},
+            {a.z() * a.x() * c - a.y() * sine, a.z() * a.y() * c + a.x() * sine, cosine + a.z() * a.z() * c, 0}
+        }};
+    }
+
+    inline constexpr Transform operator*(const Transform& other) const noexcept {
+        Transform result{};
+        for(int row = 0;row < 3;row++){
+            for(int column = 0;column < 4;column++){
+                result.m[row][column] = m[row][0] * other.m[0][column] + m[row][1] * other.m[1][column]
+                    + m[row][2] * other.m[2][column] + (column == 3? m[row][3] : 0);
+            }
+        }
+        return result;
+    }
+
+    inline constexpr Point3 point(const Point3& p) const noexcept {
+        return Point3(
+            m[0][0] * p.x() + m[0][1] * p.y() + m[0][2] * p.z() + m[0][3],
+            m[1][0] * p.x() + m[1][1] * p.y() + m[1][2] * p.z() + m[1][3],
+            m[2][0] * p.x() + m[2][1] * p.y() + m[2][2] * p.z() + m[2][3]);
+    }
+
+    inline constexpr Vec3 vector(const Vec3& v) const noexcept {
+        return Vec3(
+            m[0][0] * v.x() + m[0][1] * v.y() + m[0][2] * v.z(),
+            m[1][0] * v.x() + m[1][1] * v.y() + m[1][2] * v.z(),
+            m[2][0] * v.x() + m[2][1] * v.y() + m[2][2] * v.z());
+    }
+
+    /// @brief Multiplies the vector with the transposed linear part. Applied with the inverse
+    /// of a transform, this maps normals the way the transform maps surfaces.
+    inline constexpr Vec3 transposed_vector(const Vec3& v) const noexcept {
+        return Vec3(
+            m[0][0] * v.x() + m[1][0] * v.y() + m[2][0] * v.z(),
+            m[0][1] * v.x() + m[1][1] * v.y() + m[2][1] * v.z(),
+            m[0][2] * v.x() + m[1][2] * v.y() + m[2][2] * v.z());
+    }
+
+    /// @brief Returns the inverse transform, the linear part must not be singular.
+    inline Transform inverse() const noexcept {
+        const double cofactors[3][3] = {
+            {m[1][1] * m[2][2] - m[1][2] * m[2][1], m[0][2] * m[2][1] - m[0][1] * m[2][2],
+                m[0][1] * m[1][2] - m[0][2] * m[1][1]},
+            {m[1][2] * m[2][0] - m[1][0] * m[2][2], m[0][0] * m[2][2] - m[0][2] * m[2][0],
+                m[0][2] * m[1][0] - m[0][0] * m[1][2]},
+            {m[1][0] * m[2][1] - m[1][1] * m[2][0], m[0][1] * m[2][0] - m[0][0] * m[2][1],
+                m[0][0] * m[1][1] - m[0][1] * m[1][0]}
+        };
+        const double inverse_determinant =
+            1 / (m[0][0] * cofactors[0][0] + m[0][1] * cofactors[1][0] + m[0][2] * cofactors[2][0]);
+
+        Transform result{};
+        for(int row = 0;row < 3;row++){
+            for(int column = 0;column < 3;column++){
+                result.m[row][column] = cofactors[row][column] * inverse_determinant;
+            }
+        }
+        for(int row = 0;row < 3;row++){
+            result.m[row][3] = -(result.m[row][0] * m[0][3] + result.m[row][1] * m[1][3]
+                + result.m[row][2] * m[2][3]);
+        }
+        return result;
+    }
+
+    /// @brief Returns the smallest axis-aligned box enclosing the transformed box.
+    inline AABB box(const AABB& bounds) const noexcept {
+        if(bounds.minimum.x() > bounds.maximum.x()){
+            return bounds;
+        }
+        double minimum[3], maximum[3];
+        for(int row = 0;row < 3;row++){
+            minimum[row] = maximum[row] = m[row][3];
+            for(int column = 0;column < 3;column++){
+                const double a = m[row][column] * bounds.minimum[column];
+                const double b = m[row][column] * bounds.maximum[column];
+                minimum[row] += std::fmin(a, b);
+                maximum[row] += std::fmax(a, b);
+            }
+        }
+        return AABB(Point3(minimum[0], minimum[1], minimum[2]), Point3(maximum[0], maximum[1], maximum[2]));
+    }
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "BVH.hpp"
+#include "Hittable.hpp"
+#include "RenderStats.hpp"
+
+/// @brief Vertex position of a mesh, in single precision to halve the memory of large meshes.
+struct MeshVertex{
+    float x, y, z;
+
+    inline Point3 point() const noexcept {
+        return Point3(x, y, z);
+    }
+};
+
+/// @brief Vertices and triangles of an indexed triangle mesh, as the mesh loaders produce them.
+struct MeshData{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices; // Three vertex indices per triangle, counterclockwise seen from outside
+
+    inline size_t triangle_count() const noexcept {
+        return indices.size() / 3;
+    }
+};
+
+/// @brief Nearest triangle a ray hits, `index` is `no_hit` when it misses all of them.
+struct TriangleHit{
+    static constexpr uint32_t no_hit = UINT32_MAX;
+
+    uint32_t index = no_hit;
+    double time = INFINITY;
+};
+
+/// @brief What the watertight ray/triangle test precomputes per ray (Woop, Benthin and Wald
+/// 2013): the axis the ray mostly travels along becomes z, and a shear makes the ray point
+/// along it, so every triangle is tested in 2D from the ray origin.
+struct WatertightRay{
+    Point3 origin;
+    uint8_t kx, ky, kz; // Axes of the ray space
+    double sx, sy, sz;  // Shear and scale to the ray space
+
+    inline explicit WatertightRay(const Ray& ray) noexcept : origin(ray.origin()) {
+        const Vec3& direction = ray.direction();
+        kz = std::fabs(direction.x()) > std::fabs(direction.y())?
+            (std::fabs(direction.x()) > std::fabs(direction.z())? 0 : 2) :
+            (std::fabs(direction.y()) > std::fabs(direction.z())? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        // Swapping keeps the winding of the triangles
+        if(direction[kz] < 0){
+            std::swap(kx, ky);
+        }
+        sx = direction[kx] / direction[kz];
+        sy = direction[ky] / direction[kz];
+        sz = 1 / direction[kz];
+    }
+};
+
+/// @brief Tests the ray against the triangles in [begin, end), whose vertex indices are at
+/// 3 * triangle in `indices`. The edge tests include the edges, so a ray through an edge
+/// shared by two triangles hits at least one of them and doesn't slip through the seams of a
+/// closed mesh. Triangles are hit from both sides.
+/// The test has no early exit, so the compiler can turn it into straight-line code.
+inline TriangleHit nearest_triangle_hit(const MeshVertex* const vertices, const uint32_t* const indices,
+    const WatertightRay& ray, const Interval ray_time, const size_t begin, const size_t end) noexcept {
+    TriangleHit nearest;
+    for(size_t i = begin;i < end;i++){
+        const Vec3 a = vertices[indices[3 * i]].point() - ray.origin;
+        const Vec3 b = vertices[indices[3 * i + 1]].point() - ray.origin;
+        const Vec3 c = vertices[indices[3 * i + 2]].point() - ray.origin;
+        const double ax = a[ray.kx] - ray.sx * a[ray.kz], ay = a[ray.ky] - ray.sy * a[ray.kz];
+        const double bx = b[ray.kx] - ray.sx * b[ray.kz], by = b[ray.ky] - ray.sy * b[ray.kz];
+        const double cx = c[ray.kx] - ray.sx * c[ray.kz], cy = c[ray.ky] - ray.sy * c[ray.kz];
+
+        // Scaled barycentric coordinates, the ray passes inside if they all have the same sign
+        const double u = cx * by - cy * bx;
+        const double v = ax * cy - ay * cx;
+        const double w = bx * ay - by * ax;
+        const double determinant = u + v + w;
+        const double time = (u * ray.sz * a[ray.kz] + v * ray.sz * b[ray.kz] + w * ray.sz * c[ray.kz])
+            / determinant;
+        const bool inside = (u >= 0 && v >= 0 && w >= 0) || (u <= 0 && v <= 0 && w <= 0);
+        if(inside && determinant != 0 && ray_time.surrounds(time) && time < nearest.time){
+            nearest.index = static_cast<uint32_t>(i);
+            nearest.time = time;
+        }
+    }
+    return nearest;
+}
+
+/// @brief Indexed triangle mesh with its own BVH over the triangles, made of one material.
+/// The triangles are stored in the leaf order of the BVH, so the triangles of a leaf are
+/// consecutive, and refer to a shared vertex buffer. A triangle takes 12 bytes of indices,
+/// a vertex 12 bytes. Meshes are usually placed in the scene through instances.
+class TriangleMesh final : public Hittable {
+private:
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices; // Three per triangle, in leaf order
+    BVHTree tree;
+    uint32_t material;
+
+    inline Vec3 geometric_normal(const uint32_t triangle) const noexcept {
+        const Point3 a = vertices[indices[3 * triangle]].point();
+        const Vec3 normal = (vertices[indices[3 * triangle + 1]].point() - a).cross(
+            vertices[indices[3 * triangle + 2]].point() - a);
+        return normal.unit_vector();
+    }
+public:
+    /// @brief Builds the BVH of the mesh, the data must only refer to existing vertices.
+    inline TriangleMesh(MeshData&& data, const uint32_t material_index)
+        : vertices(std::move(data.vertices)), material(material_index) {
+        const size_t triangle_count = data.triangle_count();
+        std::vector<AABB> bounds;
+        bounds.reserve(triangle_count);
+        for(size_t i = 0;i < triangle_count;i++){
+            const Point3 a = vertices[data.indices[3 * i]].point();
+            bounds.push_back(AABB(a, a).merge(vertices[data.indices[3 * i + 1]].point())
+                .merge(vertices[data.indices[3 * i + 2]].point()));
+        }
+        tree = BVHTree(std::move(bounds));
+
+        // The leaf positions become the triangle indices
+        indices.resize(3 * tree.primitives.size());
+        for(size_t position = 0;position < tree.primitives.size();position++){
+            std::copy_n(data.indices.begin() + 3 * tree.primitives[position], 3, indices.begin() + 3 * position);
+        }
+        data.indices = std::vector<uint32_t>();
+        tree.primitives = std::vector<uint32_t>();
+    }
+
+    inline size_t triangle_count() const noexcept {
+        return indices.size() / 3;
+    }
+
+    inline size_t vertex_count() const noexcept {
+        return vertices.size();
+    }
+
+    /// @brief Returns the bytes the vertices, triangles and BVH nodes take.
+    inline size_t memory_bytes() const noexcept {
+        return vertices.capacity() * sizeof(MeshVertex) + indices.capacity() * sizeof(uint32_t)
+            + tree.nodes.capacity() * sizeof(BVHNode);
+    }
+
+    inline bool hit(const Ray& ray, const Interval ray_time, HitRecord& record) const override {
+        const WatertightRay watertight_ray(ray);
+        TriangleHit nearest;
+        const bool hit_anything = tree.traverse(ray, ray_time,
+            [&](const uint32_t begin, const uint32_t end, const Interval interval, double& closest){
+                RAY_TRACER_STAT(thread_stats().primitive_tests += end - begin);
+                const TriangleHit triangle_hit = nearest_triangle_hit(
+                    vertices.data(), indices.data(), watertight_ray, interval, begin, end);
+                if(triangle_hit.index == TriangleHit::no_hit){
+                    return false;
+                }
+                nearest = triangle_hit;
+                closest = triangle_hit.time;
+                return true;
+            });
+        if(!hit_anything){
+            return false;
+        }
+        record.point = ray.at(nearest.time);
+        record.time = nearest.time;
+        record.material = material;
+        record.set_face_normal(ray, geometric_normal(nearest.index));
+        return true;
+    }
+
+    inline AABB bounding_box() const override {
+        return tree.nodes.empty()? AABB() : tree.nodes.front().bounds;
+    }
+};
@@ -3,153 +3,169 @@
 #include <ostream>
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <type_traits>
 
 #include "Interval.hpp"
 #include "util.hpp"
 
-class Vec3{
+#ifdef RAY_TRACER_VEC3_PADDED
+constexpr size_t vec3_lanes = 4; // Pad vectors to a fourth lane, so they fill a SIMD register
+#else
+constexpr size_t vec3_lanes = 3;
+#endif
+
+/// @brief Three dimensional vector of scalar type T, a plain value type without a vtable.
+/// With 4 lanes the vector is padded with a zero lane and aligned to its size, so that
+/// element-wise operations map onto single SIMD instructions.
+template<typename T, size_t Lanes = 3>
+class alignas(Lanes == 4? 4 * sizeof(T) : alignof(T)) BasicVec3{
+    static_assert(Lanes == 3 || Lanes == 4, "BasicVec3 holds 3 elements and an optional padding lane");
 private:
-    std::array<double, 3> elements;
+    std::array<T, Lanes> elements;
 public:
-    inline constexpr Vec3() noexcept : elements{0, 0, 0} {}
-    inline constexpr Vec3(const double e0, const double e1, const double e2) noexcept :
+    using Scalar = T;
+
+    inline constexpr BasicVec3() noexcept : elements{} {}
+    inline constexpr BasicVec3(const T e0, const T e1, const T e2) noexcept :
         elements{e0, e1, e2} {}
-    inline virtual ~Vec3() noexcept {}
 
-    inline constexpr double x() const noexcept{
+    inline constexpr T x() const noexcept{
         return elements[0];
     }
 
-    inline constexpr double y() const noexcept{
+    inline constexpr T y() const noexcept{
         return elements[1];
     }
 
-    inline constexpr double z() const noexcept{
+    inline constexpr T z() const noexcept{
         return elements[2];
     }
 
-    inline Vec3 operator-() const noexcept {
-        return Vec3(-elements[0], -elements[1], -elements[2]);
+    inline constexpr BasicVec3 operator-() const noexcept {
+        return BasicVec3(-elements[0], -elements[1], -elements[2]);
     }
 
-    inline double operator[](const size_t index) const{
-        return elements.at(index);
+    inline constexpr T operator[](const size_t index) const noexcept {
+        return elements[index];
     }
 
-    inline double& operator[](const size_t index) {
-        return elements.at(index);
+    inline constexpr T& operator[](const size_t index) noexcept {
+        return elements[index];
     }
 
-    inline Vec3 operator+(const Vec3& other) const noexcept{
-        Vec3 result = *this;
+    inline constexpr BasicVec3 operator+(const BasicVec3& other) const noexcept{
+        BasicVec3 result = *this;
         result += other;
         return result;
     }
 
-    inline constexpr Vec3& operator+=(const Vec3& other) noexcept{
-        elements[0] += other.elements[0];
-        elements[1] += other.elements[1];
-        elements[2] += other.elements[2];
+    inline constexpr BasicVec3& operator+=(const BasicVec3& other) noexcept{
+        for(size_t i = 0;i < Lanes;i++){
+            elements[i] += other.elements[i];
+        }
         return *this;
     }
 
-    inline Vec3 operator-(const Vec3& other) const noexcept{
-        Vec3 result = *this;
+    inline constexpr BasicVec3 operator-(const BasicVec3& other) const noexcept{
+        BasicVec3 result = *this;
         result -= other;
         return result;
     }
 
-    inline constexpr Vec3& operator-=(const Vec3& other) noexcept{
-        elements[0] -= other.elements[0];
-        elements[1] -= other.elements[1];
-        elements[2] -= other.elements[2];
+    inline constexpr BasicVec3& operator-=(const BasicVec3& other) noexcept{
+        for(size_t i = 0;i < Lanes;i++){
+            elements[i] -= other.elements[i];
+        }
         return *this;
     }
 
-    inline Vec3 operator*(const Vec3& other) const noexcept{
-        Vec3 result = *this;
+    inline constexpr BasicVec3 operator*(const BasicVec3& other) const noexcept{
+        BasicVec3 result = *this;
         result *= other;
         return result;
     }
 
-    inline constexpr Vec3& operator*=(const Vec3& other) noexcept{
-        elements[0] *= other.elements[0];
-        elements[1] *= other.elements[1];
-        elements[2] *= other.elements[2];
+    inline constexpr BasicVec3& operator*=(const BasicVec3& other) noexcept{
+        for(size_t i = 0;i < Lanes;i++){
+            elements[i] *= other.elements[i];
+        }
         return *this;
     }
 
-    inline constexpr Vec3& operator/=(const double time) noexcept {
-        elements[0] /= time;
-        elements[1] /= time;
-        elements[2] /= time;
+    inline constexpr BasicVec3& operator/=(const T time) noexcept {
+        for(size_t i = 0;i < Lanes;i++){
+            elements[i] /= time;
+        }
         return *this;
     }
 
-    inline Vec3 operator/(const double time) const noexcept{
-        Vec3 result = *this;
+    inline constexpr BasicVec3 operator/(const T time) const noexcept{
+        BasicVec3 result = *this;
         result /= time;
         return result;
     }
-    
-    inline constexpr Vec3& operator*=(const double time) noexcept {
-        elements[0] *= time;
-        elements[1] *= time;
-        elements[2] *= time;
+
+    inline constexpr BasicVec3& operator*=(const T time) noexcept {
+        for(size_t i = 0;i < Lanes;i++){
+            elements[i] *= time;
+        }
         return *this;
     }
 
-    inline Vec3 operator*(const double time) const noexcept{
-        Vec3 result = *this;
+    inline constexpr BasicVec3 operator*(const T time) const noexcept{
+        BasicVec3 result = *this;
         result *= time;
         return result;
     }
 
-    inline constexpr double length_squared() const noexcept {
+    inline constexpr T length_squared() const noexcept {
         return elements[0] * elements[0] + elements[1] * elements[1] + elements[2] * elements[2];
     }
 
-    inline constexpr double length() const noexcept {
+    inline T length() const noexcept {
         return std::sqrt(length_squared());
     }
 
-    inline constexpr double dot(const Vec3& other) const noexcept {
+    inline constexpr T dot(const BasicVec3& other) const noexcept {
         return elements[0] * other.elements[0] + elements[1] * other.elements[1] + elements[2] *
             other.elements[2];
     }
 
-    inline Vec3 cross(const Vec3& other) const noexcept {
-        return Vec3(
+    inline constexpr BasicVec3 cross(const BasicVec3& other) const noexcept {
+        return BasicVec3(
             elements[1] * other.elements[2] - elements[2] * other.elements[1],
             elements[2] * other.elements[0] - elements[0] * other.elements[2],
             elements[0] * other.elements[1] - elements[1] * other.elements[0]
         );
     }
 
-    inline Vec3 unit_vector() const noexcept {
+    inline BasicVec3 unit_vector() const noexcept {
         return *this / length();
     }
 
-    inline static Vec3 random() {
-        return Vec3(random_double(), random_double(), random_double());
+    inline static BasicVec3 random(RandomStream& rng) noexcept {
+        const T e0 = random_double(rng), e1 = random_double(rng);
+        return BasicVec3(e0, e1, random_double(rng));
     }
 
-    inline static Vec3 random(const double minimum, const double maximum) {
-        return Vec3(random_double(minimum, maximum), random_double(minimum, maximum), random_double(minimum, maximum));
+    inline static BasicVec3 random(RandomStream& rng, const double minimum, const double maximum) noexcept {
+        const T e0 = random_double(rng, minimum, maximum), e1 = random_double(rng, minimum, maximum);
+        return BasicVec3(e0, e1, random_double(rng, minimum, maximum));
     }
 
-    inline static Vec3 random_unit_vector() {
+    inline static BasicVec3 random_unit_vector(RandomStream& rng) noexcept {
         while(true){
-            const Vec3 point = random(-1, 1);
-            const double length_squared = point.length_squared();
+            const BasicVec3 point = random(rng, -1, 1);
+            const T length_squared = point.length_squared();
             if(Interval(1e-160, 1).contains(length_squared)){
                 return point / std::sqrt(length_squared);
             }
         }
     }
 
-    inline Vec3 random_on_hemisphere() const {
-        const Vec3 on_unit_sphere = random_unit_vector();
+    inline BasicVec3 random_on_hemisphere(RandomStream& rng) const noexcept {
+        const BasicVec3 on_unit_sphere = random_unit_vector(rng);
 
         // In the same hemisphere as the normal
         if(on_unit_sphere.dot(*this) > 0.0){
@@ -159,45 +175,63 @@ public:
         }
     }
 
-    /// @brief Returns true if the vector is close to zero in all dimensions.
-    inline bool near_zero() const noexcept {
-        const double s = 1e-8;
-        for(const double element : elements){
-            if(std::fabs(element) >= s){
-                return false;
+    inline static BasicVec3 random_in_unit_disk(RandomStream& rng) noexcept {
+        while(true){
+            const T e0 = random_double(rng, -1, 1);
+            const BasicVec3 point(e0, random_double(rng, -1, 1), 0);
+            if(point.length_squared() < 1){
+                return point;
             }
         }
-        return true;
     }
 
-    inline Vec3 reflect(const Vec3& n) const noexcept {
+    /// The overloads without a stream draw from the calling thread's stream.
+    inline static BasicVec3 random() {
+        return random(thread_random_stream());
+    }
+
+    inline static BasicVec3 random(const double minimum, const double maximum) {
+        return random(thread_random_stream(), minimum, maximum);
+    }
+
+    inline static BasicVec3 random_unit_vector() {
+        return random_unit_vector(thread_random_stream());
+    }
+
+    inline static BasicVec3 random_in_unit_disk() {
+        return random_in_unit_disk(thread_random_stream());
+    }
+
+    /// @brief Returns true if the vector is close to zero in all dimensions.
+    inline bool near_zero() const noexcept {
+        const T s = 1e-8;
+        return std::fabs(elements[0]) < s && std::fabs(elements[1]) < s && std::fabs(elements[2]) < s;
+    }
+
+    inline constexpr BasicVec3 reflect(const BasicVec3& n) const noexcept {
         return *this - n * (2 * this->dot(n));
     }
 
-    inline Vec3 refract(const Vec3& n, const double etai_over_etat) const {
-        const double cos_theta = std::fmin((-*this).dot(n), 1);
-        const Vec3 r_out_perp = (*this + n * cos_theta) * etai_over_etat;
-        const Vec3 r_out_parallel = n * -std::sqrt(std::abs(1.0 - r_out_perp.length_squared()));
+    inline BasicVec3 refract(const BasicVec3& n, const T etai_over_etat) const noexcept {
+        const T cos_theta = std::fmin((-*this).dot(n), 1);
+        const BasicVec3 r_out_perp = (*this + n * cos_theta) * etai_over_etat;
+        const BasicVec3 r_out_parallel = n * -std::sqrt(std::abs(1 - r_out_perp.length_squared()));
         return r_out_perp + r_out_parallel;
     }
 
-    inline static Vec3 random_in_unit_disk() {
-        while(true){
-            const Vec3 point(random_double(-1, 1), random_double(-1, 1), 0);
-            if(point.length_squared() < 1){
-                return point;
-            }
-        }
+    inline friend constexpr BasicVec3 operator*(const T time, const BasicVec3& vec) noexcept {
+        return vec * time;
     }
 };
 
-inline Vec3 operator*(const double time, const Vec3& vec) noexcept {
-    return vec * time;
-}
-
-inline std::ostream& operator<<(std::ostream& out, const Vec3& vec){
+template<typename T, size_t Lanes>
+inline std::ostream& operator<<(std::ostream& out, const BasicVec3<T, Lanes>& vec){
     out << vec[0] << ' ' << vec[1] << ' ' << vec[2];
     return out;
 }
 
+using Vec3 = BasicVec3<Real, vec3_lanes>;
 using Point3 = Vec3;
+
+static_assert(std::is_trivially_copyable_v<Vec3>, "Vec3 must stay a plain value type");
+static_assert(sizeof(Vec3) == vec3_lanes * sizeof(Real), "Vec3 must not carry anything besides its elements");
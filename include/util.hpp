@@ -1,20 +1,81 @@
 #pragma once
 
 #include <cmath>
-#include <random>
+#include <cstdint>
+
+#ifdef RAY_TRACER_FLOAT
+using Real = float;  // Scalar type of vectors, rays and colors
+#else
+using Real = double; // Scalar type of vectors, rays and colors
+#endif
 
 inline double degrees_to_radians(const double degrees) noexcept {
     return degrees * M_PI / 180.0;
 }
 
+/// @brief Mixes a seed and a stream index into a well distributed 64-bit value (SplitMix64).
+inline constexpr uint64_t mix_seed(const uint64_t seed, const uint64_t stream) noexcept {
+    uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/// @brief Counter-based random number generator.
+/// Value number n of a stream is the SplitMix64 hash of the stream key and n, so a stream is
+/// just two integers, and what it returns doesn't depend on what any other stream drew.
+class RandomStream{
+private:
+    uint64_t key;
+    uint64_t counter; // Number of values drawn so far, the next dimension
+public:
+    inline constexpr explicit RandomStream(const uint64_t stream_key = 0, const uint64_t position = 0) noexcept
+        : key(stream_key), counter(position) {}
+
+    /// @brief Returns the stream of one sample of one pixel in a frame.
+    static inline constexpr RandomStream for_sample(
+        const uint64_t seed, const uint32_t frame, const uint64_t pixel, const uint32_t sample) noexcept {
+        return RandomStream(mix_seed(mix_seed(mix_seed(seed, frame), pixel), sample));
+    }
+
+    inline constexpr uint64_t next() noexcept {
+        return mix_seed(key, counter++);
+    }
+
+    /// @brief Returns the number of values drawn so far.
+    inline constexpr uint64_t position() const noexcept {
+        return counter;
+    }
+};
+
+/// @brief Returns a random real in [0, 1) (0 inclusive, 1 exclusive).
+inline constexpr double random_double(RandomStream& rng) noexcept {
+    return static_cast<double>(rng.next() >> 11) * 0x1.0p-53;
+}
+
+/// @brief Returns a random real in [min, max) (min inclusive, max exclusive).
+inline constexpr double random_double(RandomStream& rng, const double min, const double max) noexcept {
+    return min + (max - min) * random_double(rng);
+}
+
+/// @brief Returns the stream random_double draws from on the calling thread, for work
+/// outside of rendering such as building scenes.
+inline RandomStream& thread_random_stream() noexcept {
+    thread_local RandomStream stream;
+    return stream;
+}
+
+/// @brief Restarts the random sequence of the calling thread at the given stream of a seed.
+inline void seed_random(const uint64_t seed, const uint64_t stream) noexcept {
+    thread_random_stream() = RandomStream(mix_seed(seed, stream));
+}
+
 /// @brief Returns a random real in [0, 1) (0 inclusive, 1 exclusive).
 inline double random_double(){
-    static std::uniform_real_distribution<double> distribution;
-    static std::mt19937 generator;
-    return distribution(generator);
+    return random_double(thread_random_stream());
 }
 
 /// @brief Returns a random real in [min, max) (min inclusive, max exclusive).
 inline double random_double(const double min, const double max){
-    return min + (max - min) * random_double();
+    return random_double(thread_random_stream(), min, max);
 }
@@ -1,81 +1,251 @@
 #include <iostream>
-#include <cstdint>
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
 
-#include "Vec3.hpp"
-#include "Color.hpp"
-#include "Ray.hpp"
-#include "Sphere.hpp"
-#include "HittableList.hpp"
+#include "Animation.hpp"
+#include "BVH.hpp"
 #include "Camera.hpp"
+#include "DemoScene.hpp"
+#include "SceneFile.hpp"
 
-namespace chrono = std::chrono;
-using chrono::steady_clock;
+struct Options{
+    RenderSettings settings;
+    std::string scene_path;      // Scene file to render, the demo scene if empty
+    std::string save_scene_path; // If not empty, the scene is written to this file instead of rendered
+    std::string resume_path;     // Checkpoint to continue from
+    uint16_t samples_per_pixel = 0; // Overrides the samples per pixel of the scene if not 0
+    uint32_t image_width = 0;       // Overrides the image width of the scene if not 0
+    std::string animation_path;  // If not empty, the frames of this animation are rendered
+    std::string output_pattern;  // File names of the frames, see frame_path
+};
 
-inline double seconds_since(const steady_clock::time_point start) {
-    return static_cast<double>((steady_clock::now() - start).count()) /
-        (chrono::seconds(1) / chrono::nanoseconds(1));
+/// @brief Reads the options from the command line.
+/// Supported options: --threads <count>, --tile-size <pixels>, --seed <value>,
+/// --sampler <independent|stratified|sobol|blue-noise>, --integrator <recursive|wavefront>,
+/// --dispatch <closed|virtual>, --format <p3|p6|png|pfm>, --adaptive <noise threshold>,
+/// --min-samples <count>, --sample-map <file>, --tile-heat-map <file>, --scene <file>,
+/// --save-scene <file>, which writes the text form for files ending in .txt and the binary
+/// form otherwise, and --tiles <begin>:<end>, --samples <begin>:<end> and --shard <file> to
+/// render a part of the frame for merge_shards, --checkpoint <file>,
+/// --checkpoint-interval <seconds>, --resume <checkpoint>, --spp <samples per pixel>,
+/// --width <pixels>, --band-rows <rows> to stream the image in bands of that many rows,
+/// --roulette-depth <bounces>, 0 disabling Russian roulette, --denoise <iterations>,
+/// --denoise-strength <factor>, --feature-samples <count>, --albedo <file>, --normal <file>
+/// and --depth <file> to write the features guiding the denoiser, and
+/// --animation <file> with --output <pattern> to render all frames of an animation.
+inline Options parse_options(const int argc, const char* const argv[]) {
+    Options options;
+    RenderSettings& settings = options.settings;
+    for(int i = 1;i < argc;i += 2){
+        if(i + 1 == argc){
+            std::clog << "Missing value for option: " << argv[i] << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+        const std::string_view option = argv[i];
+        const std::string_view text = argv[i + 1];
+        const unsigned long long value = std::strtoull(argv[i + 1], nullptr, 10);
+        if(option == "--threads"){
+            settings.thread_count = static_cast<uint32_t>(value);
+        }else if(option == "--tile-size"){
+            settings.tile_size = static_cast<uint16_t>(std::max(1ull, value));
+        }else if(option == "--seed"){
+            settings.seed = value;
+        }else if(option == "--sampler" && parse_sample_pattern(text, settings.sample_pattern)){
+            // Parsed by the condition
+        }else if(option == "--integrator" && (text == "recursive" || text == "wavefront")){
+            settings.integrator = text == "wavefront"? Integrator::Wavefront : Integrator::Recursive;
+        }else if(option == "--dispatch" && (text == "closed" || text == "virtual")){
+            settings.dispatch = text == "virtual"? Dispatch::Virtual : Dispatch::Closed;
+        }else if(option == "--adaptive"){
+            settings.adaptive = true;
+            settings.noise_threshold = std::strtod(argv[i + 1], nullptr);
+        }else if(option == "--min-samples"){
+            settings.min_samples = static_cast<uint16_t>(std::max(1ull, value));
+        }else if(option == "--sample-map"){
+            settings.sample_map_path = text;
+        }else if(option == "--tile-heat-map"){
+            settings.tile_heat_map_path = text;
+        }else if((option == "--tiles" || option == "--samples") && text.find(':') != std::string_view::npos){
+            const unsigned long long end = std::strtoull(argv[i + 1] + text.find(':') + 1, nullptr, 10);
+            if(option == "--tiles"){
+                settings.tile_begin = static_cast<uint32_t>(value);
+                settings.tile_end = static_cast<uint32_t>(std::min<unsigned long long>(end, UINT32_MAX));
+            }else{
+                settings.sample_begin = static_cast<uint16_t>(std::min<unsigned long long>(value, UINT16_MAX));
+                settings.sample_end = static_cast<uint16_t>(std::min<unsigned long long>(end, UINT16_MAX));
+            }
+        }else if(option == "--shard"){
+            settings.shard_path = text;
+        }else if(option == "--checkpoint"){
+            settings.checkpoint_path = text;
+        }else if(option == "--checkpoint-interval"){
+            settings.checkpoint_interval = std::chrono::seconds(std::max(1ull, value));
+        }else if(option == "--resume"){
+            options.resume_path = text;
+        }else if(option == "--spp"){
+            options.samples_per_pixel = static_cast<uint16_t>(std::clamp(value, 1ull, 65535ull));
+        }else if(option == "--width"){
+            options.image_width = static_cast<uint32_t>(std::clamp(value, 1ull, 4294967295ull));
+        }else if(option == "--band-rows"){
+            settings.band_rows = static_cast<uint32_t>(std::clamp(value, 1ull, 4294967295ull));
+        }else if(option == "--roulette-depth"){
+            settings.roulette_depth = static_cast<uint8_t>(std::min(value, 255ull));
+        }else if(option == "--denoise"){
+            settings.denoise_iterations = static_cast<uint8_t>(std::min(value, 16ull));
+        }else if(option == "--denoise-strength"){
+            settings.denoise_strength = std::max(1e-6, std::strtod(argv[i + 1], nullptr));
+        }else if(option == "--feature-samples"){
+            settings.feature_samples = static_cast<uint16_t>(std::clamp(value, 1ull, 65535ull));
+        }else if(option == "--albedo"){
+            settings.albedo_path = text;
+        }else if(option == "--normal"){
+            settings.normal_path = text;
+        }else if(option == "--depth"){
+            settings.depth_path = text;
+        }else if(option == "--animation"){
+            options.animation_path = text;
+        }else if(option == "--output"){
+            options.output_pattern = text;
+        }else if(option == "--scene"){
+            options.scene_path = text;
+        }else if(option == "--save-scene"){
+            options.save_scene_path = text;
+        }else if(option == "--format" && parse_image_format(text, settings.format)){
+            // Parsed by the condition
+        }else{
+            std::clog << "Unknown option: " << option << ' ' << text << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    if(settings.adaptive && settings.integrator == Integrator::Wavefront){
+        std::clog << "Adaptive sampling needs the recursive integrator\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if(settings.adaptive && (settings.sample_begin != 0 || settings.sample_end != UINT16_MAX)){
+        std::clog << "Adaptive sampling can't be split into sample ranges\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if(settings.adaptive && !options.resume_path.empty()){
+        std::clog << "Adaptive sampling can't be resumed\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if(settings.band_rows > 0 && (settings.denoise_iterations > 0 || !settings.albedo_path.empty() ||
+        !settings.normal_path.empty() || !settings.depth_path.empty() || !settings.sample_map_path.empty() ||
+        !settings.tile_heat_map_path.empty() || !settings.shard_path.empty() ||
+        !settings.checkpoint_path.empty() || !options.resume_path.empty() || !options.animation_path.empty())){
+        std::clog << "Images streamed in bands can't be denoised, checkpointed, resumed, split into shards "
+            "or animated, and have no feature images, sample maps or tile heat maps\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if(!options.animation_path.empty() && (!settings.shard_path.empty() || settings.tile_begin != 0 ||
+        settings.tile_end != UINT32_MAX || settings.sample_begin != 0 || settings.sample_end != UINT16_MAX ||
+        !settings.sample_map_path.empty() || !settings.tile_heat_map_path.empty() || !settings.albedo_path.empty() ||
+        !settings.normal_path.empty() || !settings.depth_path.empty() || !settings.checkpoint_path.empty() ||
+        !options.resume_path.empty())){
+        std::clog << "Animations can't be split into shards, tiles or sample ranges, checkpointed or resumed, "
+            "and have no feature images, sample maps or tile heat maps\n";
+        std::exit(EXIT_FAILURE);
+    }
+    return options;
 }
 
-int main(){
-    const steady_clock::time_point start = steady_clock::now();
-
-    // World
-    const std::shared_ptr<Lambertian> ground_material =
-        std::make_shared<Lambertian>(Color(0.5, 0.5, 0.5));
-    HittableList world(std::make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
+int main(const int argc, const char* const argv[]){
+    const Options options = parse_options(argc, argv);
 
-    for(int8_t a = -11;a < 11;a++){
-        for(int8_t b = -11;b < 11;b++){
-            const double choose_mat = random_double();
-            const Point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+    Scene scene;
+    if(options.scene_path.empty()){
+        scene = demo_scene();
+    }else{
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::string error;
+        if(!load_scene(options.scene_path, scene, error)){
+            std::clog << options.scene_path << ": " << error << '\n';
+            return EXIT_FAILURE;
+        }
+        std::clog << "Loaded " << scene.spheres.size() << " spheres in " << std::chrono::duration<double,
+            std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+    }
 
-            if((center - Point3(4, 0.2, 0)).length() > 0.9){
-                std::shared_ptr<Material> sphere_material;
+    if(!options.save_scene_path.empty()){
+        const std::string& path = options.save_scene_path;
+        std::ofstream out(path, std::ios::binary);
+        std::string error;
+        if(path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0){
+            save_scene_text(scene, out);
+        }else if(!save_scene_binary(scene, out, error)){
+            out.close();
+            std::remove(path.c_str());
+            std::clog << path << ": " << error << '\n';
+            return EXIT_FAILURE;
+        }
+        return out? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-                if(choose_mat < 0.8){
-                    // Diffuse
-                    const Color albedo = Color::random() - Color::random();
-                    sphere_material = std::make_shared<Lambertian>(albedo);
-                    world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
-                }else if(choose_mat < 0.95){
-                    // Metal
-                    const Color albedo = Color::random(0.5, 1);
-                    const double fuzz = random_double(0, 0.5);
-                    sphere_material = std::make_shared<Metal>(albedo, fuzz);
-                    world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
-                }else{
-                    // Glass
-                    sphere_material = std::make_shared<Dielectric>(1.5);
-                    world.add(std::make_shared<Sphere>(center, 0.2, sphere_material));
-                }
+    if(!options.animation_path.empty()){
+        Animation animation;
+        std::ifstream in(options.animation_path);
+        std::string error;
+        if(!in || !load_animation(in, animation, error)){
+            std::clog << options.animation_path << ": " << (in? error : "can't open") << '\n';
+            return EXIT_FAILURE;
+        }
+        for(const SphereMotion& motion : animation.motions){
+            if(motion.sphere >= scene.spheres.size()){
+                std::clog << options.animation_path << ": there is no sphere " << motion.sphere << '\n';
+                return EXIT_FAILURE;
             }
         }
+        if(options.samples_per_pixel != 0){
+            scene.camera.samples_per_pixel = options.samples_per_pixel;
+        }
+        if(options.image_width != 0){
+            scene.camera.image_width = options.image_width;
+        }
+        const std::string pattern = options.output_pattern.empty()?
+            std::string("frame_####.") + image_extension(options.settings.format) : options.output_pattern;
+        if(!render_animation(scene, animation, options.settings, pattern, error)){
+            std::clog << error << '\n';
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
     }
 
-    const std::shared_ptr<Dielectric> material1 = std::make_shared<Dielectric>(1.5);
-    world.add(std::make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
-    
-    const std::shared_ptr<Lambertian> material2 = std::make_shared<Lambertian>(Color(0.4, 0.2, 0.1));
-    world.add(std::make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
-
-    const std::shared_ptr<Metal> material3 = std::make_shared<Metal>(Color(0.7, 0.6, 0.5), 0);
-    world.add(std::make_shared<Sphere>(Point3(4, 1, 0), 1, material3));
-
-    // Create the camera and generate the image
-    const Camera camera(
-        16.0 / 9.0,
-        1200,
-        500,
-        50,
-        20,
-        Point3(13, 2, 3),
-        Point3(0, 0, 0),
-        Vec3(0, 1, 0),
-        0.6,
-        10
-    );
-    camera.render(world);
+    if(options.samples_per_pixel != 0){
+        scene.camera.samples_per_pixel = options.samples_per_pixel;
+    }
+    if(options.image_width != 0){
+        scene.camera.image_width = options.image_width;
+    }
+    const Camera camera = scene.camera.camera();
 
-    std::clog << seconds_since(start) << " seconds\n";
+    // A resumed render continues the random streams of the checkpoint
+    RenderSettings settings = options.settings;
+    std::optional<Framebuffer> checkpoint;
+    if(!options.resume_path.empty()){
+        std::ifstream in(options.resume_path, std::ios::binary);
+        ShardHeader header;
+        std::string error;
+        checkpoint.emplace(0, 0);
+        if(!load_shard(in, *checkpoint, header, error) || !camera.can_resume(*checkpoint, header, error)){
+            std::clog << options.resume_path << ": " << error << '\n';
+            return EXIT_FAILURE;
+        }
+        settings.seed = header.seed;
+        settings.frame = header.frame;
+        settings.sample_begin = header.sample_begin;
+        settings.sample_pattern = static_cast<SamplePattern>(header.sample_pattern);
+    }
+    bool written = false;
+    dispatch_scene(settings.dispatch, BVH(scene.world()), scene.materials,
+        [&](const auto& world, const auto& materials){
+            written = camera.render(world, materials, settings, checkpoint? &*checkpoint : nullptr);
+        });
+    return written? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,311 @@
+// Measures how fast renders of a scene converge: renders it at a series of sample counts,
+// compares every render with a high sample count reference rendered by the same camera, and
+// prints the error-versus-time curve as JSON (RMSE, relMSE and SSIM against seconds).
+// Integrators, samplers and builds (like RAY_TRACER_FLOAT) are compared at equal time by
+// running it for each of them with the same --reference file: the reference is rendered and
+// saved to it as a shard the first time, and loaded from it afterwards. It is rendered with
+// the seed after the measured renders' seed, so its noise is independent of theirs, and with
+// the same settings for every run: independent samples, the recursive integrator, no adaptive
+// sampling. The scene, the contents of its mesh files, camera, sample count and seed it was
+// rendered for are saved next to it in <reference>.key, a reference whose key doesn't match is
+// rendered again. The timed series starts after an untimed render, which starts the threads
+// and faults in their memory.
+//
+// Usage: convergence [--scene <demo|glass|mirrors|file>] [--width <pixels>] [--spp <n,n,...>]
+//        [--max-spp <count>] [--max-seconds <seconds>] [--reference <shard>]
+//        [--reference-spp <count>] [--integrator <recursive|wavefront>]
+//        [--sampler <independent|stratified|sobol|blue-noise>] [--dispatch <closed|virtual>]
+//        [--adaptive <noise threshold>] [--roulette-depth <bounces>] [--threads <count>]
+//        [--seed <value>]
+// Without --spp, the sample counts are the powers of two up to --max-spp (default 64). The
+// series stops early once a render took longer than --max-seconds.
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "DemoScene.hpp"
+#include "ImageMetrics.hpp"
+#include "SceneFile.hpp"
+
+namespace chrono = std::chrono;
+using chrono::steady_clock;
+
+struct Options{
+    RenderSettings settings;
+    std::string scene = "demo";
+    uint32_t width = 320;
+    std::vector<uint16_t> sample_counts; // Powers of two up to max_samples if empty
+    uint16_t max_samples = 64;
+    double max_seconds = 0;              // No limit if 0
+    std::string reference_path;          // Reference shard to load, or to save the rendered reference to
+    uint16_t reference_samples = 1024;
+    std::string integrator = "recursive", sampler = "sobol", dispatch = "closed";
+};
+
+/// @brief One render of the series and its error.
+struct ConvergencePoint{
+    uint16_t samples;
+    double seconds;
+    ImageError error;
+};
+
+/// @brief Demo layout with every sphere made of glass: refraction makes long specular paths
+/// and caustics on the ground, which converge slowly.
+inline Scene glass_scene() {
+    Scene scene;
+    scene.add_sphere(Point3(0, -1000, 0), 1000, scene.add_material<Lambertian>(Color(0.5, 0.5, 0.5)));
+    for(int8_t a = -11;a < 11;a++){
+        for(int8_t b = -11;b < 11;b++){
+            const Point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+            scene.add_sphere(center, 0.2, scene.add_material<Dielectric>(random_double(1.3, 1.8)));
+        }
+    }
+    scene.add_sphere(Point3(0, 1, 0), 1, scene.add_material<Dielectric>(1.5));
+    scene.add_sphere(Point3(-4, 1, 0), 1, scene.add_material<Dielectric>(1.8));
+    scene.add_sphere(Point3(4, 1, 0), 1, scene.add_material<Dielectric>(1.3));
+    return scene;
+}
+
+/// @brief Closely packed spheres of slightly rough metal on a metal ground: light bounces
+/// between them many times, so paths get long and Russian roulette matters.
+inline Scene mirrors_scene() {
+    Scene scene;
+    scene.add_sphere(Point3(0, -1000, 0), 1000, scene.add_material<Metal>(Color(0.8, 0.8, 0.8), 0.05));
+    for(int8_t a = -8;a < 8;a++){
+        for(int8_t b = -8;b < 8;b++){
+            const Color albedo = Color::random(0.6, 1);
+            scene.add_sphere(Point3(a, 0.45, b), 0.45, scene.add_material<Metal>(albedo, random_double(0, 0.1)));
+        }
+    }
+    return scene;
+}
+
+/// @brief Writes a JSON string with its quotes.
+inline void write_json_string(std::ostream& out, const std::string_view text) {
+    out << '"';
+    for(const char character : text){
+        if(character == '"' || character == '\\'){
+            out << '\\';
+        }
+        out << character;
+    }
+    out << '"';
+}
+
+/// @brief Returns the 64-bit FNV-1a hash of the text.
+inline uint64_t fnv1a(const std::string_view text) noexcept {
+    uint64_t hash = 0xcbf29ce484222325;
+    for(const char character : text){
+        hash = (hash ^ static_cast<uint8_t>(character)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+/// @brief Returns the FNV-1a hash of the contents of a file, 0 if it can't be opened.
+inline uint64_t file_hash(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in){
+        return 0;
+    }
+    const std::string contents{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    return fnv1a(contents);
+}
+
+/// @brief Returns what a reference rendered with these settings depends on: the name and a
+/// hash of the scene, hashes of the mesh files it places, as the scene only names them, its
+/// camera, which holds the sample count, and the seed.
+inline std::string reference_key(const Options& options, const Scene& scene, const RenderSettings& settings) {
+    std::ostringstream scene_text;
+    save_scene_text(scene, scene_text);
+    const std::string text = scene_text.str();
+    std::ostringstream key;
+    key << "scene " << options.scene << "\nscene_hash " << std::hex << fnv1a(text) << std::dec << '\n';
+    for(const MeshPlacement& placement : scene.mesh_placements){
+        key << "mesh_hash " << placement.path << ' ' << std::hex << file_hash(placement.path) << std::dec << '\n';
+    }
+    key << text.substr(0, text.find("\n\n") + 1) // The camera parameters
+        << "seed " << settings.seed << '\n';
+    return key.str();
+}
+
+/// @brief Reads the options from the command line, exits with a message for unknown ones.
+inline Options parse_options(const int argc, const char* const argv[]) {
+    Options options;
+    RenderSettings& settings = options.settings;
+    settings.progress_interval = chrono::hours(1); // Renders are short, the progress would only clutter the log
+    for(int i = 1;i < argc;i += 2){
+        if(i + 1 == argc){
+            std::clog << "Missing value for option: " << argv[i] << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+        const std::string_view option = argv[i];
+        const std::string_view text = argv[i + 1];
+        const unsigned long long value = std::strtoull(argv[i + 1], nullptr, 10);
+        if(option == "--scene"){
+            options.scene = text;
+        }else if(option == "--width"){
+            options.width = static_cast<uint32_t>(std::clamp(value, 1ull, 4294967295ull));
+        }else if(option == "--spp"){
+            for(size_t start = 0;start < text.size();){
+                const size_t end = std::min(text.find(',', start), text.size());
+                options.sample_counts.push_back(static_cast<uint16_t>(std::clamp(
+                    std::strtoull(std::string(text.substr(start, end - start)).c_str(), nullptr, 10), 1ull, 65535ull)));
+                start = end + 1;
+            }
+        }else if(option == "--max-spp"){
+            options.max_samples = static_cast<uint16_t>(std::clamp(value, 1ull, 65535ull));
+        }else if(option == "--max-seconds"){
+            options.max_seconds = std::strtod(argv[i + 1], nullptr);
+        }else if(option == "--reference"){
+            options.reference_path = text;
+        }else if(option == "--reference-spp"){
+            options.reference_samples = static_cast<uint16_t>(std::clamp(value, 1ull, 65535ull));
+        }else if(option == "--integrator" && (text == "recursive" || text == "wavefront")){
+            settings.integrator = text == "wavefront"? Integrator::Wavefront : Integrator::Recursive;
+            options.integrator = text;
+        }else if(option == "--sampler" && parse_sample_pattern(text, settings.sample_pattern)){
+            options.sampler = text;
+        }else if(option == "--dispatch" && (text == "closed" || text == "virtual")){
+            settings.dispatch = text == "virtual"? Dispatch::Virtual : Dispatch::Closed;
+            options.dispatch = text;
+        }else if(option == "--adaptive"){
+            settings.adaptive = true;
+            settings.noise_threshold = std::strtod(argv[i + 1], nullptr);
+        }else if(option == "--roulette-depth"){
+            settings.roulette_depth = static_cast<uint8_t>(std::min(value, 255ull));
+        }else if(option == "--threads"){
+            settings.thread_count = static_cast<uint32_t>(value);
+        }else if(option == "--seed"){
+            settings.seed = value;
+        }else{
+            std::clog << "Unknown option: " << option << ' ' << text << '\n';
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    if(settings.adaptive && settings.integrator == Integrator::Wavefront){
+        std::clog << "Adaptive sampling needs the recursive integrator\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if(options.sample_counts.empty()){
+        for(uint32_t samples = 1;samples <= options.max_samples;samples *= 2){
+            options.sample_counts.push_back(static_cast<uint16_t>(samples));
+        }
+    }
+    return options;
+}
+
+int main(const int argc, const char* const argv[]){
+    const Options options = parse_options(argc, argv);
+
+    Scene scene;
+    if(options.scene == "demo"){
+        scene = demo_scene();
+    }else if(options.scene == "glass"){
+        scene = glass_scene();
+    }else if(options.scene == "mirrors"){
+        scene = mirrors_scene();
+    }else{
+        std::string error;
+        if(!load_scene(options.scene, scene, error)){
+            std::clog << options.scene << ": " << error << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    scene.camera.image_width = options.width;
+
+    // The reference is loaded if the file holds one rendered for this scene, camera, sample
+    // count and seed, rendered otherwise. The settings are the same for every run.
+    RenderSettings reference_settings;
+    reference_settings.thread_count = options.settings.thread_count;
+    reference_settings.progress_interval = options.settings.progress_interval;
+    reference_settings.seed = options.settings.seed + 1;
+    reference_settings.sample_pattern = SamplePattern::Independent;
+    reference_settings.integrator = Integrator::Recursive;
+    reference_settings.adaptive = false;
+    scene.camera.samples_per_pixel = options.reference_samples;
+    const Camera reference_camera = scene.camera.camera();
+    const std::string key = reference_key(options, scene, reference_settings);
+    const std::string key_path = options.reference_path + ".key";
+    Framebuffer reference(0, 0);
+    ShardHeader reference_header;
+    bool have_reference = false;
+    if(!options.reference_path.empty()){
+        std::ifstream in(options.reference_path, std::ios::binary);
+        std::ifstream key_in(key_path, std::ios::binary);
+        const std::string saved_key{std::istreambuf_iterator<char>(key_in), std::istreambuf_iterator<char>()};
+        std::string error;
+        have_reference = in && load_shard(in, reference, reference_header, error);
+        if(have_reference && (saved_key != key || reference.width != reference_camera.width() ||
+            reference.height != reference_camera.height())){
+            std::clog << options.reference_path << " was rendered for another scene, camera, sample count or seed"
+                " (see " << key_path << "), rendering the reference again\n";
+            have_reference = false;
+        }
+    }
+    if(!have_reference){
+        std::clog << "Rendering the reference with " << options.reference_samples << " samples per pixel\n";
+        dispatch_scene(reference_settings.dispatch, BVH(scene.world()), scene.materials,
+            [&](const auto& world, const auto& materials){
+                reference = reference_camera.render_image(world, materials, reference_settings);
+            });
+        reference_header = ShardHeader(reference, reference_settings, options.reference_samples);
+        if(!options.reference_path.empty()){
+            // The key last, so it never describes a reference that wasn't saved
+            bool saved = save_shard_file(options.reference_path, reference, reference_header);
+            if(saved){
+                std::ofstream key_out(key_path, std::ios::binary);
+                saved = static_cast<bool>(key_out << key << std::flush);
+            }
+            if(!saved){
+                std::clog << "Can't write the reference " << options.reference_path << '\n';
+            }
+        }
+    }
+
+    std::vector<ConvergencePoint> points;
+    dispatch_scene(options.settings.dispatch, BVH(scene.world()), scene.materials,
+        [&](const auto& world, const auto& materials){
+            // Untimed, so the series doesn't time starting the worker threads and faulting in their memory
+            scene.camera.samples_per_pixel = options.sample_counts.front();
+            scene.camera.camera().render_image(world, materials, options.settings);
+
+            for(const uint16_t samples : options.sample_counts){
+                scene.camera.samples_per_pixel = samples;
+                const Camera camera = scene.camera.camera();
+                const steady_clock::time_point start = steady_clock::now();
+                const Framebuffer image = camera.render_image(world, materials, options.settings);
+                const double seconds = chrono::duration<double>(steady_clock::now() - start).count();
+                points.push_back(ConvergencePoint{samples, seconds, image_error(image, reference)});
+                if(options.max_seconds > 0 && seconds > options.max_seconds){
+                    break;
+                }
+            }
+        });
+
+    std::cout << "{\n  \"scene\": ";
+    write_json_string(std::cout, options.scene);
+    std::cout << ",\n  \"width\": " << reference.width << ",\n  \"height\": " << reference.height
+        << ",\n  \"integrator\": \"" << options.integrator << "\",\n  \"sampler\": \"" << options.sampler
+        << "\",\n  \"dispatch\": \"" << options.dispatch << "\",\n  \"adaptive\": "
+        << (options.settings.adaptive? "true" : "false") << ",\n  \"real_bytes\": " << sizeof(Real)
+        << ",\n  \"reference_spp\": " << reference_header.samples_per_pixel << ",\n  \"points\": [";
+    for(size_t i = 0;i < points.size();i++){
+        const ConvergencePoint& point = points[i];
+        std::cout << (i == 0? "\n" : ",\n") << "    {\"spp\": " << point.samples << ", \"seconds\": " << point.seconds
+            << ", \"rmse\": " << point.error.rmse << ", \"relmse\": " << point.error.relmse
+            << ", \"ssim\": " << point.error.ssim << '}';
+    }
+    std::cout << "\n  ]\n}\n";
+    if(!std::cout.flush()){
+        std::clog << "Can't write the results to standard output\n";
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,111 @@
+// Merges the shards of a frame, rendered by any number of ray_tracer processes with --shard,
+// into the final image and writes it to standard output. The result has the same bits as the
+// frame rendered by a single process. Shards that hold the same samples of a pixel, like a
+// shard given twice, are rejected, as merging them would count those samples twice.
+//
+// Usage: merge_shards [--format <p3|p6|png|pfm>] [--sample-map <file>] <shard>...
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ImageEncoder.hpp"
+#include "Shard.hpp"
+
+int main(const int argc, const char* const argv[]){
+    ImageFormat format = ImageFormat::P6;
+    std::string sample_map_path;
+    std::vector<std::string> shard_paths;
+    for(int i = 1;i < argc;i++){
+        const std::string_view argument = argv[i];
+        if(argument == "--format" && i + 1 < argc && parse_image_format(argv[i + 1], format)){
+            i++;
+        }else if(argument == "--sample-map" && i + 1 < argc){
+            sample_map_path = argv[++i];
+        }else if(argument.substr(0, 2) == "--"){
+            std::clog << "Unknown option: " << argument << '\n';
+            return EXIT_FAILURE;
+        }else{
+            shard_paths.emplace_back(argument);
+        }
+    }
+    if(shard_paths.empty()){
+        std::clog << "Usage: merge_shards [--format <p3|p6|png|pfm>] [--sample-map <file>] <shard>...\n";
+        return EXIT_FAILURE;
+    }
+
+    // Pixels every merged shard has samples for, to find shards holding the same samples
+    struct MergedShard{
+        const std::string* path;
+        ShardHeader header;
+        std::vector<bool> sampled;
+    };
+    std::vector<MergedShard> merged;
+    std::optional<Framebuffer> image;
+    ShardHeader frame;
+    for(const std::string& path : shard_paths){
+        std::ifstream in(path, std::ios::binary);
+        Framebuffer shard(0, 0);
+        ShardHeader header;
+        std::string error;
+        if(!load_shard(in, shard, header, error)){
+            std::clog << path << ": " << error << '\n';
+            return EXIT_FAILURE;
+        }
+        if(image && !header.same_frame(frame)){
+            std::clog << path << ": belongs to another frame than " << shard_paths.front() << '\n';
+            return EXIT_FAILURE;
+        }
+        for(const MergedShard& other : merged){
+            if(!header.sample_ranges_overlap(other.header)){
+                continue;
+            }
+            for(size_t i = 0;i < shard.sample_counts.size();i++){
+                if(shard.sample_counts[i] > 0 && other.sampled[i]){
+                    std::clog << path << ": holds samples " << *other.path << " holds as well\n";
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        std::vector<bool> sampled(shard.sample_counts.size());
+        for(size_t i = 0;i < sampled.size();i++){
+            sampled[i] = shard.sample_counts[i] > 0;
+        }
+        merged.push_back(MergedShard{&path, header, std::move(sampled)});
+
+        if(!image){
+            image = std::move(shard);
+            frame = header;
+        }else if(!image->merge(shard)){
+            std::clog << path << ": pixels would get more than 65535 samples\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t incomplete = 0;
+    for(const uint16_t count : image->sample_counts){
+        incomplete += count < frame.samples_per_pixel;
+    }
+    if(incomplete > 0){
+        std::clog << incomplete << " pixels have fewer than " << frame.samples_per_pixel
+            << " samples, unless the frame was sampled adaptively some shards are missing\n";
+    }
+
+    if(!sample_map_path.empty()){
+        std::ofstream sample_map(sample_map_path, std::ios::binary);
+        make_encoder(format)->write(sample_map, image->sample_count_map());
+        if(!sample_map.flush()){
+            std::clog << "Can't write the sample map " << sample_map_path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    make_encoder(format)->write(std::cout, *image);
+    if(!std::cout.flush()){
+        std::clog << "Can't write the image to standard output\n";
+        return EXIT_FAILURE;
+    }
+}